@@ -1,70 +1,45 @@
 #ifndef JPS_H
 #define JPS_H
 
-#include <cmath>
-#include <queue>
-#include <unordered_set>
+// jps.hh的STL外壳：给使用std::vector网格和路径的调用者。搜索本身由JPS::Searcher完成，
+// 所以这里不再有另一份跳点搜索的实现。原来的JPS类与jps.hh的namespace JPS同名，
+// 两个头文件不能同时包含；现在它是JPS::Pathfinder。
+
 #include <vector>
 
-struct Position {
-    int x, y;
+#include "jps.hh"
 
-    bool operator==(const Position& other) const {
-        return x == other.x && y == other.y;
-    }
+namespace JPS {
 
-    Position operator+(const Position& other) const {
-        return {x + other.x, y + other.y};
-    }
-};
+// 把grid[y][x]（true = 可行走）转换成按位压缩的BitGrid。宽度取第一行的长度，
+// 较短的行缺少的格子不可行走。内存不足时返回false。
+bool toBitGrid(BitGrid& out, const std::vector<std::vector<bool>>& grid);
 
-// 为Position提供哈希函数以用于unordered_set
-struct PositionHash {
-    std::size_t operator()(const Position& pos) const {
-        return std::hash<int>()(pos.x) ^ (std::hash<int>()(pos.y) << 1);  // 哈希函数, 将x和y的哈希值进行异或运算
-    }
-};
+// 网格在构造时转换一次，之后的查询重用Searcher的内存。
+class Pathfinder {
+public:
+    explicit Pathfinder(const std::vector<std::vector<bool>>& grid, void* user = 0);
 
-struct Node {
-    Position pos;
-    Node* parent;
-    float f, g, h;
+    Pathfinder(const Pathfinder&) = delete;
+    Pathfinder& operator=(const Pathfinder&) = delete;
 
-    Node(Position p, Node* par = nullptr) : pos(p), parent(par), f(0), g(0), h(0) {
-    }
-};
+    // 从start到goal的跳点，包括两端（start == goal时只有start）。找不到路径时返回空。
+    std::vector<Position> findPath(Position start, Position goal, JPS_Flags flags = JPS_Flag_Default);
 
-// 用于优先队列的比较器
-struct CompareNode {
-    bool operator()(const Node* a, const Node* b) const {
-        return a->f > b->f;
+    const BitGrid& getGrid() const {
+        return grid_;
     }
-};
-
-class JPS {
-public:
-    JPS(const std::vector<std::vector<bool>>& grid);
-    ~JPS();
 
-    std::vector<Position> findPath(Position start, Position goal);
+    // 用于jps.hh的其他查询（步长、增量搜索、floodRange()等）
+    Searcher<BitGrid>& getSearcher() {
+        return search_;
+    }
 
 private:
-    std::vector<std::vector<bool>> grid_;
-    int width_, height_;
-    Position goal_;
-
-    // 方向数组：直线方向和对角线方向
-    static const std::vector<Position> DIRECTIONS;
-
-    bool isValid(const Position& pos) const;
-    bool isWalkable(const Position& pos) const;
-    float getHeuristic(const Position& pos) const;
-    std::vector<Position> identifySuccessors(Node* current);
-    Position jump(Position current, Position direction);
-    std::vector<Position> findNeighbors(Node* current);
-    bool hasForceNeighbor(const Position& pos, const Position& direction);
-    std::vector<Position> reconstructPath(Node* endNode);
-    void pruneNeighbors(const Position& pos, std::vector<Position>& neighbors);
+    BitGrid grid_;
+    Searcher<BitGrid> search_;
 };
 
-#endif  // JPS_H
\ No newline at end of file
+}  // end namespace JPS
+
+#endif  // JPS_H
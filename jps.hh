@@ -89,6 +89,21 @@ while(whatever)
 search.freeMemory();
 // 如果您需要知道searcher内部分配了多少内存：
 unsigned bytes = search.getTotalMemoryInUse();
+// 让searcher改用另一张地图，保留已分配的内存（例如从对象池取出的searcher）：
+search.rebind(otherGrid);
+// 限制searcher使用的内存（字节，0 = 无限制）。一次搜索需要更多内存时返回失败
+// （增量接口返回JPS_BUDGET_EXCEEDED），而不是无限增长：
+search.setMemoryLimit(4 << 20);
+// 在偶尔的大搜索之后，自动把内存缩小回最近几次搜索通常需要的大小：
+search.setAutoShrink(true);
+// 让每次查询自动选择JPS或A*（见EngineModel）；地图改变很多时重新calibrate()：
+JPS::EngineModel model;
+model.calibrate(search, width, height);
+search.setEngineModel(&model);
+search.findPath(path, a, b, 0, JPS_Flag_AutoSelect);
+// 两个searcher可以交换全部状态。C++11下Searcher还可以被移动（见JPS_HAS_MOVE），
+// 所以可以放进std::vector或交给另一个线程，不需要在堆上单独分配每一个。
+search.swap(otherSearcher);
 // -------------------------------
 // --- 增量路径查找 ---
 // -------------------------------
@@ -102,10 +117,11 @@ unsigned bytes = search.getTotalMemoryInUse();
 - JPS_EMPTY_PATH如果点相等且未被阻挡
 - JPS_FOUND_PATH如果初始贪婪启发式可以快速找到路径。
 - JPS_OUT_OF_MEMORY如果...好吧，是的。
+- JPS_BUDGET_EXCEEDED如果超出了setMemoryLimit()设置的限制。
 If it returns JPS_NEED_MORE_STEPS then the next part can start.
 重复调用
   ### JPS_Result res = search.findPathStep(int limit) ###
-直到它返回JPS_NO_PATH或JPS_FOUND_PATH，或JPS_OUT_OF_MEMORY。
+直到它返回JPS_NO_PATH或JPS_FOUND_PATH，或JPS_OUT_OF_MEMORY（或JPS_BUDGET_EXCEEDED）。
 为了保持一致性，您将希望确保网格在后续调用之间不会发生变化；
 如果网格发生变化，部分路径可能会穿过现在被阻挡的区域，或者可能不再是最优的。
 如果limit为0，它将一次性执行路径查找。值> 0暂停搜索
@@ -126,12 +142,26 @@ If it returns JPS_NEED_MORE_STEPS then the next part can start.
 则找到的路径仍对生成路径向量有效。
 在这种情况下，您可以在释放一些内存后再次调用findPathFinish()。
 如果您不担心内存，将JPS_OUT_OF_MEMORY视为JPS_NO_PATH。
+JPS_BUDGET_EXCEEDED的处理与JPS_OUT_OF_MEMORY相同；提高限制后调用findPathInit()重新开始。
+不想分配内存时，可以先用search.getPathLength(step)得到路径的确切长度，
+然后用search.writePath(buf, bufSize, step)把路径直接写进您自己的缓冲区。
+如果单位每帧只走几格，不必生成逐格路径：只保存路径点（step = 0），
+用JPS::StepIterator按需得到逐格的位置（与step > 0时的路径相同，见StepIteratorT）。
 您可以传递JPS::PathVector、std::vector或您自己的findPathFinish()。
 注意，如果传递的路径向量类型在分配失败时抛出异常（例如std::vector），
 您将获得该异常，并且路径向量将处于成功插入最后一个元素时的状态。
 如果未抛出异常（即您使用JPS::PathVector），则失败情况不会修改路径向量。
 您可以随时通过findPathInit()、freeMemory()或销毁searcher实例来中止搜索。
 中止或开始搜索将reset()返回的值。getStepsDone()和.getNodesExpanded()到0。
+// -------------------------------
+// --- 3D体素网格 ---
+// -------------------------------
+文件末尾的JPS3D命名空间提供了同样接口的3D版本（26邻居，不允许切角）。
+网格类需要重载`operator()(x, y, z) const`；JPS3D::VoxelGrid是一个现成的按位存储的实现。
+  JPS3D::Searcher<JPS3D::VoxelGrid> search3(voxels);
+  JPS3D::PathVector path3;
+  bool found = search3.findPath(path3, JPS3D::Pos(x0, y0, z0), JPS3D::Pos(x1, y1, z1), step);
+标志、步长、增量接口（findPathInit/Step/Finish）与2D版本相同。
 */
 // ============================
 // ====== COMPILE CONFIG ======
@@ -161,6 +191,15 @@ If it returns JPS_NEED_MORE_STEPS then the next part can start.
 #define JPS_free(p, oldsize, user) free(p)
 #endif
 #endif
+// C++11编译器上，Searcher和PodVec支持移动构造和移动赋值（例如放进std::vector、对象池，或交给另一个线程）。
+// 预先定义为0以保持纯C++98。swap()和rebind()在两种情况下都可用。
+#ifndef JPS_HAS_MOVE
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#define JPS_HAS_MOVE 1
+#else
+#define JPS_HAS_MOVE 0
+#endif
+#endif
 #ifdef JPS_NO_FLOAT
 #define JPS_HEURISTIC_ACCURATE(a, b) (Heuristic::Chebyshev(a, b))
 #else
@@ -224,13 +263,34 @@ enum JPS_Flags_ {
     JPS_Flag_NoStartCheck = 0x04,
     // 不要检查目标位置是否可行走。
     JPS_Flag_NoEndCheck = 0x08,
+    // 只允许上下左右4个方向移动，不允许对角线移动（路径代价即曼哈顿距离）。
+    // 跳跃规则相应改变：水平跳跃在出现强制的垂直邻居时停止，
+    // 垂直跳跃在每一步向左右两侧做水平跳跃。贪婪检查和A*模式同样只走直线。
+    // 仅适用于2D Searcher；JPS3D忽略此标志。
+    JPS_Flag_FourConnected = 0x10,
+    // 移动目标模式（MT-Adaptive A*），用于追逐移动的目标：每隔几帧用稍微移动了的目标重新搜索。
+    // 带这个标志的搜索找到路径后，它的已关闭节点学到更准确的启发式（路径代价 - g），
+    // 下一次带这个标志的搜索使用它们（目标移动时用学到的值做修正），所以只需要展开一小部分节点。
+    // 学到的值在searcher中保留到resetMovingTarget()、rebind()或freeMemory()；地图改变时必须调用其中之一。
+    // 学到的值只对目标的变化有效，起点可以任意变化。JPS3D同样支持；WeightedSearcher忽略此标志。
+    JPS_Flag_MovingTarget = 0x20,
+    // 贪婪检查先用raycast()检查起点到目标的任意方向的直线，能看到目标时完全跳过搜索。
+    // 找到的路径只有一段，方向可以不是直线或对角线；step > 0时沿raycast()检查过的格子逐格输出，
+    // 所以每一步仍然是合法的移动，步数也是最短的。和JPS_Flag_NoGreedy或JPS_Flag_FourConnected一起时无效。
+    // 仅适用于2D Searcher。
+    JPS_Flag_RaycastGreedy = 0x40,
+    // 按Searcher::setEngineModel()设置的EngineModel为每次查询选择JPS或A*（JPS_Flag_AStarOnly），
+    // 并且像JPS_Flag_RaycastGreedy一样先检查直线。没有设置模型时只检查直线。
+    // 选择只在使用运行时标志的策略（如DefaultPolicy）下有效。仅适用于2D Searcher。
+    JPS_Flag_AutoSelect = 0x80
 };
 enum JPS_Result {
     JPS_NO_PATH,          // 没有找到路径
     JPS_FOUND_PATH,       // 找到路径
     JPS_NEED_MORE_STEPS,  // 需要更多的步骤
     JPS_EMPTY_PATH,       // 路径为空
-    JPS_OUT_OF_MEMORY     // 内存不足
+    JPS_OUT_OF_MEMORY,    // 内存不足
+    JPS_BUDGET_EXCEEDED   // 超出setMemoryLimit()设置的内存限制
 };
 // operator new() without #include <new>
 // 不幸的是，标准要求使用size_t，所以我们需要stddef.h至少。
@@ -259,8 +319,22 @@ struct Position {
         return x != PosType(-1);
     }
 };
+// 3D位置，用于JPS3D
+struct Position3 {
+    PosType x, y, z;
+    inline bool operator==(const Position3& p) const {
+        return x == p.x && y == p.y && z == p.z;
+    }
+    inline bool operator!=(const Position3& p) const {
+        return x != p.x || y != p.y || z != p.z;
+    }
+    inline bool isValid() const {
+        return x != PosType(-1);
+    }
+};
 // 无效位置。用于内部标记不可行走的点。
 static const Position npos = {PosType(-1), PosType(-1)};
+static const Position3 npos3 = {PosType(-1), PosType(-1), PosType(-1)};
 static const SizeT noidx = SizeT(-1);
 // ctor函数，以保持Position是一个真正的POD结构。
 inline static Position Pos(PosType x, PosType y) {
@@ -269,6 +343,13 @@ inline static Position Pos(PosType x, PosType y) {
     p.y = y;
     return p;
 }
+inline static Position3 Pos3(PosType x, PosType y, PosType z) {
+    Position3 p;
+    p.x = x;
+    p.y = y;
+    p.z = z;
+    return p;
+}
 template <typename T>
 inline static T Max(T a, T b) {
     return a < b ? b : a;
@@ -286,6 +367,52 @@ template <typename T>
 inline static int Sgn(T val) {
     return (T(0) < val) - (val < T(0));
 }
+// 最高的置位的位置，x不能为0
+inline static unsigned HighBit(unsigned x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 31 - __builtin_clz(x);
+#else
+    unsigned r = 0;
+    while (x >>= 1)
+        ++r;
+    return r;
+#endif
+}
+// 路径段（两个相邻路径点之间）的长度是切比雪夫距离，即逐格走完它的步数。
+// 段通常是直线或对角线；只有JPS_Flag_RaycastGreedy找到的路径有其他方向的段（见raycast()）。
+inline static int SegmentLength(const Position& a, const Position& b) {
+    const int dx = Abs(int(a.x - b.x));
+    const int dy = Abs(int(a.y - b.y));
+    return Max(dx, dy);
+}
+inline static int SegmentLength(const Position3& a, const Position3& b) {
+    const int dx = Abs(int(a.x - b.x));
+    const int dy = Abs(int(a.y - b.y));
+    const int dz = Abs(int(a.z - b.z));
+    const int len = Max(Max(dx, dy), dz);
+    JPS_ASSERT((!dx || dx == len) && (!dy || dy == len) && (!dz || dz == len));
+    return len;
+}
+// 长度为n的直线上第k格的一个坐标相对于起点的偏移，d是这个轴上的总偏移：k * d / n四舍五入，
+// 正好一半时取较小的坐标。这个规则与方向无关，所以从a到b和从b到a经过同样的格子。
+// 坐标小于65536时精确。
+inline static int LineOffset(int d, int n, int k) {
+    const unsigned p = unsigned(k) * unsigned(Abs(d));
+    const unsigned q = p / unsigned(n), r = p % unsigned(n);
+    return d >= 0 ? int(q + (2 * r > unsigned(n))) : -int(q + (2 * r >= unsigned(n)));
+}
+// 从a向b走k格
+inline static Position SegmentPoint(const Position& a, const Position& b, int k) {
+    const int dx = int(b.x - a.x);
+    const int dy = int(b.y - a.y);
+    if (!dx || !dy || Abs(dx) == Abs(dy))
+        return Pos(a.x + k * Sgn(dx), a.y + k * Sgn(dy));
+    const int n = Max(Abs(dx), Abs(dy));
+    return Pos(a.x + LineOffset(dx, n, k), a.y + LineOffset(dy, n, k));
+}
+inline static Position3 SegmentPoint(const Position3& a, const Position3& b, int k) {
+    return Pos3(a.x + k * Sgn(int(b.x - a.x)), a.y + k * Sgn(int(b.y - a.y)), a.z + k * Sgn(int(b.z - a.z)));
+}
 // 启发式。如果需要，请添加新的启发式。
 namespace Heuristic {
 // 曼哈顿距离
@@ -308,13 +435,124 @@ inline ScoreType Euclidean(const Position& a, const Position& b) {
     return static_cast<ScoreType>(JPS_sqrt(dx * dx + dy * dy));
 }
 #endif
+// 3D版本
+inline ScoreType Manhattan(const Position3& a, const Position3& b) {
+    const int dx = Abs(int(a.x - b.x));
+    const int dy = Abs(int(a.y - b.y));
+    const int dz = Abs(int(a.z - b.z));
+    return static_cast<ScoreType>(dx + dy + dz);
+}
+inline ScoreType Chebyshev(const Position3& a, const Position3& b) {
+    const int dx = Abs(int(a.x - b.x));
+    const int dy = Abs(int(a.y - b.y));
+    const int dz = Abs(int(a.z - b.z));
+    return static_cast<ScoreType>(Max(Max(dx, dy), dz));
+}
+#ifdef JPS_sqrt
+inline ScoreType Euclidean(const Position3& a, const Position3& b) {
+    const int dx = (int(a.x - b.x));
+    const int dy = (int(a.y - b.y));
+    const int dz = (int(a.z - b.z));
+    return static_cast<ScoreType>(JPS_sqrt(dx * dx + dy * dy + dz * dz));
+}
+#endif
 }  // namespace Heuristic
+// 搜索策略：Searcher的第二个模板参数，在编译时决定搜索的配置。
+// - Flags()：返回实际使用的标志（邻居生成、跳跃方式、贪婪检查、起点/终点检查、对角线规则）。
+// - Accurate()/Estimate()：启发式对，含义同JPS_HEURISTIC_ACCURATE/JPS_HEURISTIC_ESTIMATE。
+// - Neighbors()/Jump()/Greedy()：2D Searcher通过这些钩子生成邻居、跳跃和做贪婪检查。
+//   默认调用Searcher的内置实现（按标志选择8方向、4方向或A*）。
+// DefaultPolicy使用传给findPath*()的运行时标志。FixedPolicy<F>忽略运行时标志而总是使用F，
+// 这样所有的标志检查都是常量，编译器为每种配置生成没有分支的内循环：
+//   JPS::Searcher<MyGrid, JPS::FixedPolicy<JPS_Flag_NoGreedy> > search(grid);
+// 自定义策略可以从它们派生并隐藏其中的函数，例如用其他启发式，或者换掉跳跃的实现。
+// 对角线规则（内置的是不能穿过墙角）由Neighbors()和Jump()一起决定，换规则时两个都要换，
+// 并且Accurate()必须与之一致。钩子中可以通过s.getGrid()、s._getEndPos()访问网格和目标，
+// 也可以调用s._findNeighbors()、s._jump()、s._findPathGreedy()来包装内置实现。
+struct DefaultPolicy {
+    static inline JPS_Flags Flags(JPS_Flags runtimeFlags) {
+        return runtimeFlags;
+    }
+    template <typename POS>
+    static inline ScoreType Accurate(const POS& a, const POS& b) {
+        return JPS_HEURISTIC_ACCURATE(a, b);
+    }
+    template <typename POS>
+    static inline ScoreType Estimate(const POS& a, const POS& b) {
+        return JPS_HEURISTIC_ESTIMATE(a, b);
+    }
+    // 把节点n的后继位置（最多8个，都必须可行走）写入w，返回数量。
+    // 不是JPS_Flag_AStarOnly时，每个后继再经过Jump()。
+    template <typename S, typename NODE>
+    static inline unsigned Neighbors(S& s, const NODE& n, Position* w) {
+        return s._findNeighbors(n, w);
+    }
+    // 从src走到p之后沿同一方向继续，返回下一个跳点（包括目标），没有时返回npos
+    template <typename S>
+    static inline Position Jump(S& s, const Position& p, const Position& src) {
+        return s._jump(p, src);
+    }
+    // 在A*之前尝试直接连接起点和目标；成功时设置目标节点的父节点并返回true。
+    // JPS_Flag_NoGreedy时不调用。
+    template <typename S, typename NODE>
+    static inline bool Greedy(S& s, NODE* start, NODE* end) {
+        return s._findPathGreedy(start, end);
+    }
+};
+template <JPS_Flags F>
+struct FixedPolicy : public DefaultPolicy {
+    static inline JPS_Flags Flags(JPS_Flags) {
+        return F;
+    }
+};
+// 惰性的逐格路径：从路径点（step = 0时的路径）按需生成的位置序列与step > 0时的路径完全相同，
+// 但不需要把整条逐格路径存下来。每帧只走几格的单位只需要保存路径点和这个迭代器。
+// 不拥有路径点数组，迭代期间它必须保持有效。
+//   JPS::PathVector waypoints;
+//   search.findPath(waypoints, start, end, 0);
+//   JPS::StepIterator it(start, waypoints.data(), waypoints.size(), 1);
+//   JPS::Position p;
+//   while (it.next(p)) ...
+template <typename POS>
+class StepIteratorT {
+public:
+    StepIteratorT() : _wp(0), _n(0), _i(0), _k(0), _step(1) {
+    }
+    StepIteratorT(const POS& start, const POS* waypoints, SizeT n, unsigned step = 1)
+        : _from(start), _wp(waypoints), _n(n), _i(0), _k(0), _step(step ? step : 1) {
+    }
+    bool next(POS& out) {
+        while (!_k) {
+            if (_i == _n)
+                return false;
+            if (_i)
+                _from = _wp[_i - 1];
+            _k = (SegmentLength(_wp[_i], _from) + _step - 1) / _step;
+            ++_i;
+        }
+        // 和generatePath()一样，从段的终点向回以步长对齐
+        --_k;
+        out = SegmentPoint(_wp[_i - 1], _from, int(_k * _step));
+        return true;
+    }
+    inline bool done() const {
+        return !_k && _i == _n;
+    }
+private:
+    POS _from;
+    const POS* _wp;
+    SizeT _n, _i;
+    unsigned _k, _step;
+};
 // --- 开始基础设施，数据结构 ---
 namespace Internal {
 // 永远不会分配在PodVec<Node>之外 --> 所有节点在内存中是线性相邻的。
-struct Node {
-    ScoreType f, g;   // 启发式距离
-    Position pos;     // 位置
+// POS是Position或Position3。SCORE是代价类型（加权搜索使用整数代价）。
+template <typename POS, typename SCORE = ScoreType>
+struct NodeT {
+    typedef POS PositionT;
+    SCORE f, g;       // 启发式距离
+    POS pos;          // 位置
     int parentOffs;   // 没有父节点如果为0
     unsigned _flags;  // 标志
     inline int hasParent() const {
@@ -326,6 +564,9 @@ struct Node {
     inline void setClosed() {
         _flags |= 2;
     }  // 设置为封闭
+    inline void reopen() {
+        _flags &= ~2u;
+    }  // 取消封闭，仍然是开放的（移动目标模式）
     inline unsigned isOpen() const {
         return _flags & 1;
     }  // 是否开放
@@ -333,22 +574,28 @@ struct Node {
         return _flags & 2;
     }  // 是否封闭
     // 我们知道节点在内存中是顺序分配的，所以这是可以的。
-    inline Node& getParent() {
+    inline NodeT& getParent() {
         JPS_ASSERT(parentOffs);
         return this[parentOffs];
     }  // 获取父节点
-    inline const Node& getParent() const {
+    inline const NodeT& getParent() const {
         JPS_ASSERT(parentOffs);
         return this[parentOffs];
     }  // 获取父节点
-    inline const Node* getParentOpt() const {
+    inline const NodeT* getParentOpt() const {
         return parentOffs ? this + parentOffs : 0;
     }  // 获取父节点
-    inline void setParent(const Node& p) {
+    inline void setParent(const NodeT& p) {
         JPS_ASSERT(&p != this);
         parentOffs = static_cast<int>(&p - this);
     }  // 设置父节点
 };
+template <typename T>
+inline static void Swap(T& a, T& b) {
+    const T tmp = a;
+    a = b;
+    b = tmp;
+}
 // 模板类，用于管理节点
 template <typename T>
 class PodVec {
@@ -358,6 +605,33 @@ public:
     ~PodVec() {
         dealloc();
     }
+#if JPS_HAS_MOVE
+    PodVec(PodVec<T>&& o) : _data(o._data), used(o.used), cap(o.cap), _user(o._user) {
+        o._data = 0;
+        o.used = 0;
+        o.cap = 0;
+    }
+    PodVec<T>& operator=(PodVec<T>&& o) {
+        if (this != &o) {
+            dealloc();
+            _data = o._data;
+            used = o.used;
+            cap = o.cap;
+            _user = o._user;
+            o._data = 0;
+            o.used = 0;
+            o.cap = 0;
+        }
+        return *this;
+    }
+#endif
+    // 交换内容，包括user指针（内存必须由分配它的user释放）
+    void _swap(PodVec<T>& o) {
+        Swap(_data, o._data);
+        Swap(used, o.used);
+        Swap(cap, o.cap);
+        Swap(_user, o._user);
+    }
     inline void clear() {
         used = 0;
     }
@@ -418,6 +692,28 @@ public:
     SizeT _getMemSize() const {
         return cap * sizeof(T);
     }
+    inline SizeT capacity() const {
+        return cap;
+    }
+    // 下一次alloc()之后的内存大小（需要扩容时是扩容后的大小）
+    SizeT _nextMemSize() const {
+        return (used < cap ? cap : _nextcap()) * sizeof(T);
+    }
+    // 把容量缩小到newcap（不小于当前大小）。realloc失败时保持不变。
+    void _shrink(SizeT newcap) {
+        JPS_ASSERT(used <= newcap);
+        if (newcap >= cap)
+            return;
+        if (!newcap) {
+            dealloc();
+            return;
+        }
+        void* p = JPS_realloc((void*)_data, newcap * sizeof(T), cap * sizeof(T), _user);
+        if (p) {
+            _data = (T*)p;
+            cap = newcap;
+        }
+    }
     // 最小迭代器接口
     typedef T* iterator;              // 迭代器
     typedef const T* const_iterator;  // 常量迭代器
@@ -438,176 +734,302 @@ public:
 private:
     void* _grow(SizeT newcap)  // 增长
     {
-        void* p = JPS_realloc(_data, newcap * sizeof(T), cap * sizeof(T), _user);
+        void* p = JPS_realloc((void*)_data, newcap * sizeof(T), cap * sizeof(T), _user);  // PodVec<PodVec<..>>也是按字节移动的
         if (p) {
             _data = (T*)p;
             cap = newcap;
         }
         return p;
     }
+    inline SizeT _nextcap() const {
+        return cap + (cap / 2) + 32;
+    }
     void* _grow() {
-        const SizeT newcap = cap + (cap / 2) + 32;
-        return _grow(newcap);
+        return _grow(_nextcap());
     }
     T* _data;         // 数据
     SizeT used, cap;  // 使用，容量
 public:
-    void* const _user;
+    void* _user;
 private:
     // 禁止操作
     PodVec<T>& operator=(const PodVec<T>&);
     PodVec(const PodVec<T>&);
 };
-template <typename T>
-inline static void Swap(T& a, T& b) {
-    const T tmp = a;
-    a = b;
-    b = tmp;
+typedef NodeT<Position> Node;
+typedef NodeT<Position3> Node3;
+typedef PodVec<Node> Storage;
+// 打包的位置，用作哈希表的键（2D中x, y都小于65536时是唯一的；否则和3D一样可能冲突）
+static inline unsigned PosKey(const Position& p) {
+    return (p.y << 16) ^ p.x;
 }
-template <typename IT>
-inline static void Reverse(IT first, IT last) {
-    while ((first != last) && (first != --last)) {
-        Swap(*first, *last);
-        ++first;
-    }
+static inline unsigned PosKey(const Position3& p) {
+    return (p.z << 22) ^ (p.y << 11) ^ p.x;
 }
-typedef PodVec<Node> Storage;
-// 节点映射
-class NodeMap {
+// 节点映射：位置 -> 中央存储中的节点。
+// 单个扁平的开放寻址哈希表（线性探测），每个槽存储一个32位的键和节点索引。
+// 键是打包的位置（2D中x, y都小于65536时是唯一的；否则和3D一样可能冲突，所以找到键后总是比较节点的位置）。
+// 槽的位置来自键的乘法（Fibonacci）哈希，这样对角线上的位置（x ^ y相同）也能很好地分散。
+// 扩大时原地realloc，然后从中央存储重建（存储才是真实数据）。
+template <typename NODE>
+class NodeMapT {
 private:
-    static const unsigned LOAD_FACTOR = 8;       // 估计：{CPU缓存行大小(64)} / sizeof(HashLoc)
-    static const unsigned INITIAL_BUCKETS = 16;  // 必须大于1且为2的幂
-    struct HashLoc {
-        unsigned hash2;  // 仅用于早期检查
-        SizeT idx;       // 在中央存储中的索引
+    static const unsigned INITIAL_SLOTS = 64;  // 必须是2的幂
+    struct Slot {
+        unsigned key;
+        SizeT idx;  // 在中央存储中的索引；noidx = 空槽
     };
-    typedef PodVec<HashLoc> Bucket;  // 桶
-    // 哈希函数，用于确定桶。仅使用低几位。应该很好地混淆低几位。
-    static inline unsigned Hash(PosType x, PosType y) {
-        return x ^ y;
+    typedef typename NODE::PositionT POS;
+    typedef PodVec<NODE> StorageT;
+    static inline unsigned Key(const POS& p) {
+        return PosKey(p);
     }
-    // 哈希函数，设计为尽可能少地丢失数据。用于早期检查。所有位都使用。
-    static inline unsigned Hash2(PosType x, PosType y) {
-        return (y << 16) ^ x;
+    inline SizeT _home(unsigned key) const {
+        return (key * 2654435769u) >> _shift;
     }
 public:
-    NodeMap(Storage& storage) : _storageRef(storage), _buckets(storage._user) {
-    }
-    ~NodeMap() {
-        dealloc();
+    NodeMapT(StorageT& storage) : _storageRef(storage), _slots(storage._user), _shift(32) {
     }
     void dealloc() {
-        for (SizeT i = 0; i < _buckets.size(); ++i)
-            _buckets[i].~Bucket();
-        _buckets.dealloc();
+        _slots.dealloc();
+        _shift = 32;
+    }
+    // 为下一个新节点扩容之后的内存大小
+    SizeT _nextMemSize() const {
+        const SizeT cap = _slots.size();
+        return ((_storageRef.size() + 1) * 2 > cap ? (cap ? cap * 2 : INITIAL_SLOTS) : cap) * sizeof(Slot);
+    }
+    // 缩小到足够容纳n个节点的大小。只能在存储为空时调用（clear()之后）。
+    void _shrink(SizeT n) {
+        JPS_ASSERT(_storageRef.empty());
+        SizeT cap = INITIAL_SLOTS;
+        while (cap < n * 2)
+            cap *= 2;
+        if (cap < _slots.size()) {
+            _slots.clear();
+            _slots._shrink(cap);
+            _rehash(cap);  // 不会失败，容量已经足够
+        }
+    }
+    // 只交换槽，绑定的存储不变（调用者同时交换两个存储）
+    void _swap(NodeMapT& o) {
+        _slots._swap(o._slots);
+        Swap(_shift, o._shift);
     }
     void clear() {
-        // 清除桶，但*不*清除桶向量
-        for (SizeT i = 0; i < _buckets.size(); ++i)
-            _buckets[i].clear();
+        // 在清空中央存储之前调用，节点仍然可用。
+        // 上次搜索很小时只清除它使用的槽，而不是整个（可能很大的）表：
+        // 从每个节点的起始槽开始清除到下一个空槽为止，这覆盖了所有被占用的槽。
+        const SizeT n = _storageRef.size();
+        const SizeT cap = _slots.size();
+        Slot* const slots = _slots.data();
+        if (n * 8 < cap) {
+            const SizeT mask = cap - 1;
+            for (SizeT i = 0; i < n; ++i)
+                for (SizeT s = _home(Key(_storageRef[i].pos)); slots[s].idx != noidx; s = (s + 1) & mask)
+                    slots[s].idx = noidx;
+        } else {
+            for (SizeT i = 0; i < cap; ++i)
+                slots[i].idx = noidx;
+        }
     }
-    Node* operator()(PosType x, PosType y) {
-        const unsigned h = Hash(x, y);
-        const unsigned h2 = Hash2(x, y);
-        const SizeT ksz = _buckets.size();  // 已知为2的幂
-        Bucket* b = 0;                      // MSVC /W4 抱怨这个未初始化且使用，所以我们初始化它...
-        if (ksz) {
-            b = &_buckets[h & (ksz - 1)];
-            const SizeT bsz = b->size();
-            const HashLoc* const bdata = b->data();
-            for (SizeT i = 0; i < bsz; ++i) {
-                // 这是唯一使用HashLoc::hash2的地方；它可以被移除，这意味着：
-                // - 两次空间用于索引每缓存行
-                // - 但也有更高的机会出现缓存未命中，因为对于每个桶中的条目，我们仍然需要检查节点的X/Y坐标，
-                //   并且我们最终可能会在RAM的随机位置结束。
-                // 快速基准测试表明，*使用*hash2检查，它几乎无法测量（小于1%）更快。
-                if (bdata[i].hash2 == h2) {
-                    Node& n = _storageRef[bdata[i].idx];
-                    if (n.pos.x == x && n.pos.y == y)
+    NODE* operator()(const POS& pos) {
+        const unsigned key = Key(pos);
+        SizeT cap = _slots.size();  // 已知为2的幂
+        SizeT s = 0;
+        if (cap) {
+            const SizeT mask = cap - 1;
+            const Slot* const slots = _slots.data();
+            for (s = _home(key); slots[s].idx != noidx; s = (s + 1) & mask)
+                if (slots[s].key == key) {
+                    NODE& n = _storageRef[slots[s].idx];
+                    if (n.pos == pos)
                         return &n;
                 }
+        }
+        // 没有节点在pos，创建新节点。负载因子保持在1/2以下，这样探测序列很短。
+        const SizeT idx = _storageRef.size();
+        if ((idx + 1) * 2 > cap) {
+            cap = cap ? cap * 2 : INITIAL_SLOTS;
+            if (!_rehash(cap))
+                return 0;
+            const SizeT mask = cap - 1;
+            for (s = _home(key); _slots[s].idx != noidx; s = (s + 1) & mask) {
             }
         }
-        // 如果需要，扩大哈希图；如果需要，修复桶
-        SizeT newbsz = _enlarge();
-        if (newbsz > 1)
-            b = &_buckets[h & (newbsz - 1)];
-        else if (newbsz == 1)  // 错误情况
-            return 0;
-        HashLoc* loc = b->alloc();  // ... see above. b is always initialized here. when ksz==0, _enlarge() will do its
-                                    // initial allocation, so it can never return 0.
-        if (!loc)
-            return 0;
-        loc->hash2 = h2;
-        loc->idx = _storageRef.size();
-        // 没有节点在(x, y)，创建新节点
-        Node* n = _storageRef.alloc();
+        NODE* n = _storageRef.alloc();
         if (n) {
             n->f = 0;
             n->g = 0;
-            n->pos.x = x;
-            n->pos.y = y;
+            n->pos = pos;
             n->parentOffs = 0;
             n->_flags = 0;
+            _slots[s].key = key;
+            _slots[s].idx = idx;
         }
         return n;
     }
+    // 只查找，不创建节点
+    const NODE* find(const POS& pos) const {
+        const SizeT cap = _slots.size();
+        if (!cap)
+            return 0;
+        const unsigned key = Key(pos);
+        const SizeT mask = cap - 1;
+        const Slot* const slots = _slots.data();
+        for (SizeT s = _home(key); slots[s].idx != noidx; s = (s + 1) & mask)
+            if (slots[s].key == key) {
+                const NODE& n = _storageRef[slots[s].idx];
+                if (n.pos == pos)
+                    return &n;
+            }
+        return 0;
+    }
     SizeT _getMemSize() const {
-        SizeT sum = _buckets._getMemSize();
-        for (Buckets::const_iterator it = _buckets.cbegin(); it != _buckets.cend(); ++it)
-            sum += it->_getMemSize();
-        return sum;
+        return _slots._getMemSize();
     }
 private:
-    // 返回值：0 = 没有要做的；1 = 错误；>1：内部存储被扩大到这个桶的数量
-    SizeT _enlarge() {
+    bool _rehash(SizeT newcap) {
+        _slots.resize(newcap);
+        if (_slots.size() != newcap)
+            return false;  // realloc失败，旧表保持不变
+        _shift = 32 - HighBit(newcap);
+        Slot* const slots = _slots.data();
+        for (SizeT i = 0; i < newcap; ++i)
+            slots[i].idx = noidx;
+        const SizeT mask = newcap - 1;
         const SizeT n = _storageRef.size();
-        const SizeT oldsz = _buckets.size();
-        if (n < oldsz * LOAD_FACTOR)
-            return 0;
-        // 预先分配桶存储，我们即将使用
-        const SizeT newsz = oldsz ? oldsz * 2 : INITIAL_BUCKETS;  // 保持为2的幂
-        if (!_buckets._reserve(newsz))
-            return 0;  // 如果realloc失败，则提前退出；这不是问题，我们可以继续。
-        // 忘记所有内容
-        for (SizeT i = 0; i < oldsz; ++i)
-            _buckets[i].clear();
-        // 调整大小并初始化
-        for (SizeT i = oldsz; i < newsz; ++i) {
-            void* p = _buckets.alloc();  // 不能失败，因为空间已经预留
-            JPS_PLACEMENT_NEW(p) PodVec<HashLoc>(_buckets._user);
-        }
-        const SizeT mask = _buckets.size() - 1;
         for (SizeT i = 0; i < n; ++i) {
-            const Position p = _storageRef[i].pos;
-            HashLoc* loc = _buckets[Hash(p.x, p.y) & mask].alloc();
-            if (!loc)
-                return 1;  // error case
-            loc->hash2 = Hash2(p.x, p.y);
-            loc->idx = i;
+            const unsigned key = Key(_storageRef[i].pos);
+            SizeT s = _home(key);
+            while (slots[s].idx != noidx)
+                s = (s + 1) & mask;
+            slots[s].key = key;
+            slots[s].idx = i;
         }
-        return newsz;
+        return true;
     }
-    Storage& _storageRef;
-    typedef PodVec<Bucket> Buckets;
-    Buckets _buckets;
+    StorageT& _storageRef;
+    PodVec<Slot> _slots;
+    unsigned _shift;  // 32 - log2(槽数量)
+};
+typedef NodeMapT<Node> NodeMap;
+// 位置 -> 分数的开放寻址哈希表（线性探测，负载因子不超过1/2），用于移动目标模式记住学到的启发式。
+// 与NodeMapT不同，它独立于中央存储，在多次搜索之间保留。
+template <typename POS>
+class ScoreMapT {
+private:
+    static const unsigned INITIAL_SLOTS = 256;  // 必须是2的幂
+    struct Slot {
+        POS pos;  // 无效位置 = 空槽
+        ScoreType v;
+    };
+    inline SizeT _home(const POS& p) const {
+        return (PosKey(p) * 2654435769u) >> _shift;
+    }
+public:
+    ScoreMapT(void* user) : _slots(user), _used(0), _shift(32) {
+    }
+    bool get(const POS& pos, ScoreType& v) const {
+        const SizeT cap = _slots.size();
+        if (!cap)
+            return false;
+        const SizeT mask = cap - 1;
+        for (SizeT s = _home(pos); _slots[s].pos.isValid(); s = (s + 1) & mask)
+            if (_slots[s].pos == pos) {
+                v = _slots[s].v;
+                return true;
+            }
+        return false;
+    }
+    // 插入或覆盖。内存不足时返回false。
+    bool set(const POS& pos, ScoreType v) {
+        if ((_used + 1) * 2 > _slots.size() && !_rehash(_slots.size() ? _slots.size() * 2 : INITIAL_SLOTS))
+            return false;
+        const SizeT mask = _slots.size() - 1;
+        SizeT s = _home(pos);
+        for (; _slots[s].pos.isValid(); s = (s + 1) & mask)
+            if (_slots[s].pos == pos) {
+                _slots[s].v = v;
+                return true;
+            }
+        _slots[s].pos = pos;
+        _slots[s].v = v;
+        ++_used;
+        return true;
+    }
+    void clear() {
+        if (!_used)
+            return;
+        for (SizeT i = 0; i < _slots.size(); ++i)
+            _slots[i].pos.x = PosType(-1);
+        _used = 0;
+    }
+    void dealloc() {
+        _slots.dealloc();
+        _used = 0;
+        _shift = 32;
+    }
+    inline SizeT size() const {
+        return _used;
+    }
+    SizeT _getMemSize() const {
+        return _slots._getMemSize();
+    }
+    // 插入一个新值（包括可能的扩容）之后的内存大小
+    SizeT _nextMemSize() const {
+        const SizeT cap = _slots.size();
+        return ((_used + 1) * 2 > cap ? (cap ? cap * 2 : INITIAL_SLOTS) : cap) * sizeof(Slot);
+    }
+    void _swap(ScoreMapT& o) {
+        _slots._swap(o._slots);
+        Swap(_used, o._used);
+        Swap(_shift, o._shift);
+    }
+private:
+    bool _rehash(SizeT newcap) {
+        PodVec<Slot> old(_slots._user);
+        old._swap(_slots);
+        _slots.resize(newcap);
+        if (_slots.size() != newcap) {
+            _slots._swap(old);  // 保持旧表不变
+            return false;
+        }
+        _shift = 32 - HighBit(newcap);
+        for (SizeT i = 0; i < newcap; ++i)
+            _slots[i].pos.x = PosType(-1);
+        const SizeT mask = newcap - 1;
+        for (SizeT i = 0; i < old.size(); ++i)
+            if (old[i].pos.isValid()) {
+                SizeT s = _home(old[i].pos);
+                while (_slots[s].pos.isValid())
+                    s = (s + 1) & mask;
+                _slots[s] = old[i];
+            }
+        return true;
+    }
+    PodVec<Slot> _slots;
+    SizeT _used;
+    unsigned _shift;  // 32 - log2(槽数量)
 };
 // 开放列表
-class OpenList {
+template <typename NODE>
+class OpenListT {
 private:
-    const Storage& _storageRef;
+    typedef PodVec<NODE> StorageT;
+    const StorageT& _storageRef;
     PodVec<SizeT> idxHeap;
 public:
-    OpenList(const Storage& storage) : _storageRef(storage), idxHeap(storage._user) {
+    OpenListT(const StorageT& storage) : _storageRef(storage), idxHeap(storage._user) {
     }
-    inline void pushNode(Node* n) {
+    inline void pushNode(NODE* n) {
         _heapPushIdx(_storageRef.getindex(n));
     }
-    inline Node& popNode() {
+    inline NODE& popNode() {
         return _storageRef[_popIdx()];
     }
     // 重新堆化，因为节点改变了它的顺序
-    inline void fixNode(const Node& n) {
+    inline void fixNode(const NODE& n) {
         const unsigned ni = _storageRef.getindex(&n);
         const unsigned sz = idxHeap.size();
         unsigned* p = idxHeap.data();      // 获取堆数据
@@ -621,6 +1043,15 @@ public:
     inline void dealloc() {
         idxHeap.dealloc();
     }
+    inline void _swap(OpenListT& o) {
+        idxHeap._swap(o.idxHeap);
+    }
+    inline SizeT _nextMemSize() const {
+        return idxHeap._nextMemSize();
+    }
+    inline void _shrink(SizeT n) {
+        idxHeap._shrink(n);
+    }
     inline void clear() {
         idxHeap.clear();
     }
@@ -689,179 +1120,907 @@ private:
         _percolateUp(i);
     }
 };
-#undef JPS_PLACEMENT_NEW
-// --- 结束基础设施，数据结构 ---
-// 那些不依赖于模板参数的东西...
-class SearcherBase {
-protected:
-    Storage storage;  // 存储
-    OpenList open;    // 开放列表
-    NodeMap nodemap;  // 节点映射
-    Position endPos;
-    SizeT endNodeIdx;
-    JPS_Flags flags;
-    int stepsRemain;
-    SizeT stepsDone;
-    SearcherBase(void* user)
-        : storage(user),
-          open(storage),
-          nodemap(storage),
-          endPos(npos),
-          endNodeIdx(noidx),
-          flags(0),
-          stepsRemain(0),
-          stepsDone(0) {
+typedef OpenListT<Node> OpenList;
+// 单调桶队列（radix heap），用于整数代价的搜索（WeightedSearcher）。
+// 要求弹出的键单调不减，一致的启发式保证了这一点。
+// 桶0存放等于上次弹出的键的条目，桶i（i > 0）存放与上次弹出的键最高不同位为i-1的条目。
+// push()是O(1)，pop()均摊O(log C)。
+// 不支持decrease-key：调用者重新压入节点，并在弹出时跳过已关闭的节点。
+class BucketQueue {
+public:
+    struct Entry {
+        unsigned key;
+        SizeT idx;
+    };
+    BucketQueue(void* user) : _buckets(user), _last(0), _count(0) {
+    }
+    ~BucketQueue() {
+        dealloc();
     }
     void clear() {
-        open.clear();
-        nodemap.clear();
-        storage.clear();
-        endNodeIdx = noidx;
-        stepsDone = 0;
+        for (SizeT i = 0; i < _buckets.size(); ++i)
+            _buckets[i].clear();
+        _last = 0;
+        _count = 0;
     }
-    // 扩展节点，思路是：
-    // 1. 计算额外代价
-    // 2. 计算新代价
-    // 3. 如果节点不在开放列表中，或者新代价小于节点代价，则更新节点
-    // 4. 如果节点不在开放列表中，则将节点加入开放列表
-    // 5. 如果节点在开放列表中，则更新节点，更新之后会影响其他节点
-    // 参数：
-    // jp: 目标位置
-    // jn: 目标节点
-    // parent: 父节点
-    void _expandNode(const Position jp, Node& jn, const Node& parent) {
-        JPS_ASSERT(jn.pos == jp);                                   // 确保节点是正确的
-        ScoreType extraG = JPS_HEURISTIC_ACCURATE(jp, parent.pos);  // 计算额外代价
-        ScoreType newG = parent.g + extraG;                         // 计算新代价
-        if (!jn.isOpen() || newG < jn.g) {  // 如果节点不在开放列表中，或者新代价小于节点代价，则更新节点
-            jn.g = newG;                    // 更新节点代价
-            jn.f = jn.g + JPS_HEURISTIC_ESTIMATE(jp, endPos);  // 计算新f值
-            jn.setParent(parent);                              // 设置父节点
-            if (!jn.isOpen()) {      // 如果节点不在开放列表中，则将节点加入开放列表
-                open.pushNode(&jn);  // 将节点加入开放列表
-                jn.setOpen();        // 设置节点为开放
-            } else
-                open.fixNode(jn);  // 如果节点在开放列表中，则更新节点
+    void dealloc() {
+        for (SizeT i = 0; i < _buckets.size(); ++i)
+            _buckets[i].~Bucket();
+        _buckets.dealloc();
+        _last = 0;
+        _count = 0;
+    }
+    // 在clear()之后调用：每个桶最多保留n个条目的容量
+    void _shrink(SizeT n) {
+        for (SizeT i = 0; i < _buckets.size(); ++i)
+            _buckets[i]._shrink(n);
+    }
+    void _swap(BucketQueue& o) {
+        _buckets._swap(o._buckets);
+        Swap(_last, o._last);
+        Swap(_count, o._count);
+    }
+    inline bool empty() const {
+        return !_count;
+    }
+    // 返回false表示内存不足
+    bool push(unsigned key, SizeT idx) {
+        if (_buckets.empty() && !_init())
+            return false;
+        if (key < _last)
+            key = _last;  // 启发式不一致时保持结构有效（结果可能不再是最优的）
+        Entry* e = _buckets[_bucketOf(key)].alloc();
+        if (!e)
+            return false;
+        e->key = key;
+        e->idx = idx;
+        ++_count;
+        return true;
+    }
+    // 弹出键最小的条目。返回false表示内存不足，此时队列不变。
+    bool pop(Entry& out) {
+        JPS_ASSERT(_count);
+        if (_buckets[0].empty()) {
+            SizeT i = 1;
+            while (_buckets[i].empty())
+                ++i;
+            Bucket& b = _buckets[i];
+            const SizeT bsz = b.size();
+            unsigned m = b[0].key;
+            for (SizeT j = 1; j < bsz; ++j)
+                m = Min(m, b[j].key);
+            // 先预留空间，这样分配失败时不会丢失条目
+            SizeT counts[NUM_BUCKETS] = {0};
+            for (SizeT j = 0; j < bsz; ++j)
+                ++counts[_bucketOf(b[j].key, m)];
+            for (SizeT k = 0; k < i; ++k)
+                if (counts[k] && !_buckets[k]._reserve(_buckets[k].size() + counts[k]))
+                    return false;
+            _last = m;
+            for (SizeT j = 0; j < bsz; ++j) {
+                const Entry e = b[j];
+                *_buckets[_bucketOf(e.key)].alloc() = e;  // 不会失败，空间已经预留
+            }
+            b.clear();
         }
+        --_count;
+        out = _buckets[0].back();
+        _buckets[0].pop_back();
+        return true;
     }
-public:
-    template <typename PV>
-    JPS_Result generatePath(PV& path, unsigned step) const;
-    void freeMemory() {
-        open.dealloc();
-        nodemap.dealloc();
-        storage.dealloc();
-        endNodeIdx = noidx;
+    SizeT _getMemSize() const {
+        SizeT sum = _buckets._getMemSize();
+        for (Buckets::const_iterator it = _buckets.cbegin(); it != _buckets.cend(); ++it)
+            sum += it->_getMemSize();
+        return sum;
     }
-    // --- Statistics ---
-    inline SizeT getStepsDone() const {
-        return stepsDone;
+private:
+    static const unsigned NUM_BUCKETS = 33;
+    typedef PodVec<Entry> Bucket;
+    typedef PodVec<Bucket> Buckets;
+    static inline unsigned _bucketOf(unsigned key, unsigned last) {
+        return key == last ? 0 : 1 + HighBit(key ^ last);
     }
-    inline SizeT getNodesExpanded() const {
-        return storage.size();
+    inline unsigned _bucketOf(unsigned key) const {
+        return _bucketOf(key, _last);
     }
-    SizeT getTotalMemoryInUse() const {
-        return storage._getMemSize() + nodemap._getMemSize() + open._getMemSize();
+    bool _init() {
+        if (!_buckets._reserve(NUM_BUCKETS))
+            return false;
+        for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+            void* p = _buckets.alloc();  // 不能失败，因为空间已经预留
+            JPS_PLACEMENT_NEW(p) Bucket(_buckets._user);
+        }
+        return true;
     }
+    Buckets _buckets;
+    unsigned _last;
+    SizeT _count;
 };
-template <typename GRID>
-class Searcher : public SearcherBase {
+#undef JPS_PLACEMENT_NEW
+// 网格仿函数的指针包装，调用方式和网格本身一样。
+// Searcher保存它而不是引用，这样rebind()可以让同一个Searcher（和它已分配的内存）改用另一个网格。
+template <typename GRID, typename R = bool>
+class GridRef {
 public:
-    Searcher(const GRID& g, void* user = 0) : SearcherBase(user), grid(g) {
+    GridRef(const GRID& g) : _g(&g) {
+    }
+    inline R operator()(PosType x, PosType y) const {
+        return (*_g)(x, y);
+    }
+    inline R operator()(PosType x, PosType y, PosType z) const {
+        return (*_g)(x, y, z);
+    }
+    inline const GRID& get() const {
+        return *_g;
     }
-    // 单次调用
-    template <typename PV>
-    bool findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags = JPS_Flag_Default);
-    // 增量路径查找
-    JPS_Result findPathInit(Position start, Position end, JPS_Flags flags = JPS_Flag_Default);
-    JPS_Result findPathStep(int limit);
-    // 生成路径，在找到路径后
-    template <typename PV>
-    JPS_Result findPathFinish(PV& path, unsigned step) const;
 private:
-    const GRID& grid;
-    Node* getNode(const Position& pos);
-    bool identifySuccessors(const Node& n);
-    bool findPathGreedy(Node* start, Node* end);
+    const GRID* _g;
+};
+// 每个searcher的内存策略：
+// - limit：存储、节点映射和开放列表合计的字节数上限，0表示无限制。
+//   分配新节点之前检查，如果分配（包括可能的扩容）会超出限制，搜索以JPS_BUDGET_EXCEEDED结束。
+// - 自动收缩：记录每次搜索使用的节点数的高水位，它在每次搜索后衰减1/8。
+//   当容器的容量超过高水位（加一次扩容的余量）的两倍时，在下一次搜索开始时把它们缩小回去，
+//   这样偶尔一次很大的搜索不会让searcher一直占着大量内存。
+// 移动目标模式学到的启发式（2D和3D Searcher）也计入limit：学习在达到限制时停止，
+// 搜索需要分配节点而内存不够时先丢弃学到的值。自动收缩不缩小它，freeMemory()释放它。
+struct MemBudget {
+    SizeT limit;
+    SizeT watermark;
+    bool autoShrink;
+    bool exceeded;
+    MemBudget() : limit(0), watermark(0), autoShrink(false), exceeded(false) {
+    }
+    // 在分配新节点之前调用，bytes是分配之后的总内存
+    inline bool allow(SizeT bytes) {
+        if (limit && bytes > limit) {
+            exceeded = true;
+            return false;
+        }
+        return true;
+    }
+    // 分配失败时的结果
+    inline JPS_Result failResult() const {
+        return exceeded ? JPS_BUDGET_EXCEEDED : JPS_OUT_OF_MEMORY;
+    }
+    // 在清空容器之后调用，n是上次搜索使用的节点数，cap是当前的存储容量。
+    // 返回应该缩小到的容量（节点数），0表示不需要缩小。
+    SizeT decay(SizeT n, SizeT cap) {
+        exceeded = false;
+        if (!autoShrink)
+            return 0;
+        watermark = Max(n, watermark - (watermark >> 3));
+        const SizeT keep = watermark + (watermark >> 1) + 32;
+        return cap > keep * 2 ? keep : 0;
+    }
+};
+// 路径的位置数量：step = 0时每个路径点一个，否则每段ceil(段长 / step)个。不包括起点；没有路径时为0。
+template <typename NODE>
+SizeT PathLength(const PodVec<NODE>& storage, SizeT endNodeIdx, unsigned step) {
+    if (endNodeIdx == noidx)
+        return 0;
+    SizeT len = 0;
+    const NODE* next = &storage[endNodeIdx];
+    for (const NODE* prev = next->getParentOpt(); prev; next = prev, prev = prev->getParentOpt())
+        len += step ? (SegmentLength(next->pos, prev->pos) + step - 1) / step : 1;
+    return len;
+}
+// 沿父节点回溯，从out（路径末尾之后）往前写PathLength()个位置，这样结果是正序的，不需要反转
+template <typename NODE, typename IT>
+void WritePathBackwards(const PodVec<NODE>& storage, SizeT endNodeIdx, IT out, unsigned step) {
+    const NODE* next = &storage[endNodeIdx];
+    for (const NODE* prev = next->getParentOpt(); prev; next = prev, prev = prev->getParentOpt()) {
+        JPS_ASSERT(next != prev);
+        if (step) {
+            const int steps = SegmentLength(next->pos, prev->pos);
+            for (int i = 0; i < steps; i += step)
+                *--out = SegmentPoint(next->pos, prev->pos, i);
+        } else
+            *--out = next->pos;
+    }
+}
+// --- 结束基础设施，数据结构 ---
+}  // end namespace Internal
+
+// ====== 视线 ======
+// raycast(grid, a, b)：从a到b的直线是否可以通过。直线上的格子和SegmentPoint()相同，每一步都是
+// 合法的移动（对角线移动与Searcher的规则一样，不能穿过两个不可行走格子之间的角），
+// 所以可以直接用作路径：步数就是切比雪夫距离，与A*找到的最短路径相同。
+// 不检查a本身。用于路径平滑、视野和投射物；JPS_Flag_RaycastGreedy用它作为更一般的贪婪检查。
+// 只适用于8方向移动。
+
+// 逐格遍历从a到b（不含a）的直线，每步只需要加法
+class LineWalker {
+public:
+    LineWalker(const Position& a, const Position& b)
+        : _a(a), _dx(int(b.x - a.x)), _dy(int(b.y - a.y)), _k(0), _qx(0), _rx(0), _qy(0), _ry(0) {
+        _n = Max(Abs(_dx), Abs(_dy));
+    }
+    inline bool next(Position& p) {
+        if (_k == _n)
+            return false;
+        ++_k;
+        p = Pos(_a.x + _advance(_qx, _rx, _dx), _a.y + _advance(_qy, _ry, _dy));
+        return true;
+    }
+private:
+    // 增量地计算LineOffset(d, n, k)：q, r是k * |d|除以n的商和余数
+    inline int _advance(unsigned& q, unsigned& r, int d) const {
+        r += unsigned(Abs(d));
+        if (r >= unsigned(_n)) {
+            r -= unsigned(_n);
+            ++q;
+        }
+        return d >= 0 ? int(q + (2 * r > unsigned(_n))) : -int(q + (2 * r >= unsigned(_n)));
+    }
+    Position _a;
+    int _dx, _dy, _n, _k;
+    unsigned _qx, _rx, _qy, _ry;
+};
+template <typename GRID>
+bool raycast(const GRID& grid, const Position& a, const Position& b) {
+    LineWalker line(a, b);
+    Position p = a, q;
+    while (line.next(q)) {
+        if (!grid(q.x, q.y))
+            return false;
+        if (q.x != p.x && q.y != p.y && !grid(q.x, p.y) && !grid(p.x, q.y))
+            return false;
+        p = q;
+    }
+    return true;
+}
+// 按位压缩的2D网格，每个格子1位（1 = 可行走）。可以直接作为Searcher的GRID使用。
+// 和JPS3D::VoxelGrid一样，内存通过JPS_realloc/JPS_free分配。
+// raycast()对它有更快的版本：一行内的连续格子按整个字测试。
+class BitGrid {
+public:
+    BitGrid(void* user = 0) : w(0), h(0), rowWords(0), bits(user) {
+    }
+    // 分配并清空（全部不可行走）。内存不足时返回false。
+    bool init(PosType width, PosType height) {
+        const SizeT rw = (width + 31) / 32;
+        bits.clear();
+        bits.resize(rw * height);
+        if (bits.size() != rw * height) {
+            w = h = rowWords = 0;
+            return false;
+        }
+        w = width;
+        h = height;
+        rowWords = rw;
+        for (SizeT i = 0; i < bits.size(); ++i)
+            bits[i] = 0;
+        return true;
+    }
+    inline void set(PosType x, PosType y, bool walkable) {
+        JPS_ASSERT(x < w && y < h);
+        unsigned& word = bits[SizeT(y) * rowWords + (x >> 5)];
+        const unsigned m = 1u << (x & 31);
+        word = walkable ? (word | m) : (word & ~m);
+    }
+    inline unsigned operator()(PosType x, PosType y) const {
+        return x < w && y < h && ((bits[SizeT(y) * rowWords + (x >> 5)] >> (x & 31)) & 1);
+    }
+    // 第y行的[x0, x1]是否全部可行走（必须在网格内，x0 <= x1）
+    bool isSpanWalkable(PosType x0, PosType x1, PosType y) const {
+        JPS_ASSERT(x0 <= x1 && x1 < w && y < h);
+        const unsigned* row = bits.data() + SizeT(y) * rowWords;
+        const SizeT w0 = x0 >> 5, w1 = x1 >> 5;
+        const unsigned lo = ~0u << (x0 & 31);        // x0及之后的位
+        const unsigned hi = ~0u >> (31 - (x1 & 31));  // x1及之前的位
+        if (w0 == w1)
+            return (row[w0] & (lo & hi)) == (lo & hi);
+        if ((row[w0] & lo) != lo || (row[w1] & hi) != hi)
+            return false;
+        for (SizeT i = w0 + 1; i < w1; ++i)
+            if (row[i] != ~0u)
+                return false;
+        return true;
+    }
+    inline PosType width() const {
+        return w;
+    }
+    inline PosType height() const {
+        return h;
+    }
+    SizeT _getMemSize() const {
+        return bits._getMemSize();
+    }
+private:
+    PosType w, h;
+    SizeT rowWords;
+    Internal::PodVec<unsigned> bits;
+};
+// BitGrid的raycast()：x方向为主的直线（|dx| >= |dy|）在每一行上是一段连续的格子。
+// 每一段的长度从误差项直接算出来，整段按字测试，换行时只单独检查角，不需要逐格走。
+// y方向为主的直线每行只有一个格子，使用一般的版本。
+inline bool raycast(const BitGrid& grid, const Position& a, const Position& b) {
+    const int dx = int(b.x - a.x);
+    const int dy = int(b.y - a.y);
+    const int n = Abs(dx), ay = Abs(dy);
+    if (n < ay || a.x >= grid.width() || a.y >= grid.height() || b.x >= grid.width() || b.y >= grid.height())
+        return raycast<BitGrid>(grid, a, b);  // 越界的情况由operator()处理
+    const int sx = Sgn(dx), sy = Sgn(dy);
+    // 与LineOffset()相同：e >= 0时y移动一格。正好一半的情况向较小的坐标取整，所以dy >= 0时偏移1。
+    int e = -n - (dy >= 0);
+    PosType x = a.x, y = a.y;
+    int k = 0, run = 0;  // 当前行的段：以x结尾的run个格子（第一行不包括a）
+    while (true) {
+        const int j = ay ? (2 * ay - 1 - e) / (2 * ay) : n + 1;  // 再走j步换行
+        if (j > n - k) {
+            run += n - k;
+            x += (n - k) * sx;
+            return !run || grid.isSpanWalkable(sx > 0 ? x - (run - 1) : x, sx > 0 ? x : x + (run - 1), y);
+        }
+        run += j - 1;
+        x += (j - 1) * sx;
+        if (run && !grid.isSpanWalkable(sx > 0 ? x - (run - 1) : x, sx > 0 ? x : x + (run - 1), y))
+            return false;
+        if (!grid(x + sx, y) && !grid(x, y + sy))
+            return false;
+        x += sx;
+        y += sy;
+        k += j;
+        e += 2 * ay * j - 2 * n;
+        run = 1;
+    }
+}
+
+// ====== 自动选择算法 ======
+// JPS在大多数地图上比A*快得多，但每次搜索都要向各个方向扫描到墙为止，所以在开阔地图上的
+// 短查询中A*可能更快。哪一个更快取决于地图，障碍物密度之类的统计不足以预测，
+// 所以calibrate()直接在地图上取样查询：对每个距离范围，用两种算法搜索同样的几个查询
+// （直线被挡住的；能看到目标时JPS_Flag_AutoSelect完全跳过搜索），记住哪一个的工作量更小。
+// 工作量 = stepCost * getStepsDone() + nodeCost * getNodesExpanded()；两个权重是一次网格查询和
+// 一个节点的相对开销，取决于网格的实现。默认值1:10适合每次查询只有几条指令的网格；
+// test/jps/testjps2.cpp测量示例地图的权重并输出。
+class EngineModel {
+public:
+    enum { NUM_BUCKETS = 16 };  // 切比雪夫距离d按2的幂分组：第i组是[2^i, 2^(i+1))
+    EngineModel(unsigned stepCost = 1, unsigned nodeCost = 10) {
+        clear();
+        setCosts(stepCost, nodeCost);
+    }
+    void clear() {
+        for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+            _samples[i] = 0;
+            _steps[0][i] = _steps[1][i] = _nodes[0][i] = _nodes[1][i] = 0;
+        }
+        _astar = 0;
+    }
+    // 改变权重不需要重新取样
+    void setCosts(unsigned stepCost, unsigned nodeCost) {
+        _stepCost = stepCost;
+        _nodeCost = nodeCost;
+        _update();
+    }
+    // 在w x h的地图上，为每个距离组取样最多samples个查询（起点和目标可行走、直线被挡住、有路径），
+    // 用search（及其网格和内存）分别以JPS和A*搜索。flags是以后使用的其他标志（例如JPS_Flag_FourConnected）。
+    // 之前的取样被丢弃；search上正在进行的搜索被中止，它的内存被释放。返回取样的查询数量。
+    template <typename SEARCHER>
+    unsigned calibrate(SEARCHER& search, unsigned w, unsigned h, unsigned samples = 16,
+                       JPS_Flags flags = JPS_Flag_Default, unsigned seed = 1) {
+        clear();
+        flags = (flags | JPS_Flag_NoGreedy) & ~(JPS_Flag_AStarOnly | JPS_Flag_AutoSelect | JPS_Flag_MovingTarget);
+        unsigned total = 0;
+        for (unsigned b = 0; b < NUM_BUCKETS && (1u << b) < Max(w, h); ++b) {
+            const unsigned lo = 1u << b;
+            for (unsigned tries = 0; tries < samples * 32 && _samples[b] < samples; ++tries) {
+                const Position a = Pos(_rand(seed) % w, _rand(seed) % h);
+                const unsigned d = lo + _rand(seed) % lo;
+                const int o = int(_rand(seed) % (2 * d + 1)) - int(d);  // 另一个方向的偏移
+                const int sd = (_rand(seed) & 1) ? int(d) : -int(d);
+                const bool xmajor = _rand(seed) & 1;
+                const Position t = Pos(a.x + (xmajor ? sd : o), a.y + (xmajor ? o : sd));
+                if (t.x >= w || t.y >= h || !search.getGrid()(a.x, a.y) || !search.getGrid()(t.x, t.y))
+                    continue;
+                if (!(flags & JPS_Flag_FourConnected) && raycast(search.getGrid(), a, t))
+                    continue;
+                SizeT steps[2], nodes[2];
+                bool found = true;
+                for (unsigned e = 0; e < 2 && found; ++e) {
+                    JPS_Result res = search.findPathInit(a, t, flags | (e ? JPS_Flag_AStarOnly : 0));
+                    while (res == JPS_NEED_MORE_STEPS)
+                        res = search.findPathStep(0);
+                    found = res == JPS_FOUND_PATH;
+                    steps[e] = search.getStepsDone();
+                    nodes[e] = search.getNodesExpanded();
+                }
+                if (!found)
+                    continue;
+                for (unsigned e = 0; e < 2; ++e) {
+                    _steps[e][b] += steps[e];
+                    _nodes[e][b] += nodes[e];
+                }
+                ++_samples[b];
+                ++total;
+            }
+        }
+        // 取样的A*搜索可能分配了很多内存，很大的节点表会让之后的小搜索变慢
+        search.freeMemory();
+        _update();
+        return total;
+    }
+    // 从a到b的查询应该使用的标志：JPS_Flag_AStarOnly或0
+    inline JPS_Flags select(const Position& a, const Position& b) const {
+        const unsigned d = Heuristic::Chebyshev(a, b);
+        return d && ((_astar >> _bucket(d)) & 1) ? JPS_Flag_AStarOnly : JPS_Flag_Default;
+    }
+    // --- 取样结果 ---
+    inline bool prefersAStar(unsigned bucket) const {
+        return (_astar >> bucket) & 1;
+    }
+    inline unsigned getNumSamples(unsigned bucket) const {
+        return _samples[bucket];
+    }
+    // 一个距离组里所有取样查询的工作量之和
+    inline unsigned long getWork(unsigned bucket, bool astar) const {
+        return _stepCost * _steps[astar][bucket] + _nodeCost * _nodes[astar][bucket];
+    }
+private:
+    unsigned _stepCost, _nodeCost;
+    unsigned _samples[NUM_BUCKETS];
+    unsigned long _steps[2][NUM_BUCKETS], _nodes[2][NUM_BUCKETS];  // [0] = JPS，[1] = A*
+    unsigned _astar;  // 位集：A*更快的距离组；没有取样的组使用JPS
+    void _update() {
+        _astar = 0;
+        for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+            if (_samples[i] && getWork(i, true) < getWork(i, false))
+                _astar |= 1u << i;
+    }
+    static unsigned _bucket(unsigned d) {
+        unsigned b = 0;
+        while ((d >>= 1) && b < NUM_BUCKETS - 1)
+            ++b;
+        return b;
+    }
+    static unsigned _rand(unsigned& seed) {
+        seed = seed * 1103515245u + 12345u;
+        return seed >> 8;
+    }
+};
+
+namespace Internal {
+// 那些不依赖于模板参数的东西...（2D和3D共用）
+template <typename NODE>
+class SearcherBaseT {
+protected:
+    typedef NODE NodeType;
+    typedef typename NODE::PositionT POS;
+    PodVec<NODE> storage;     // 存储
+    OpenListT<NODE> open;     // 开放列表
+    NodeMapT<NODE> nodemap;   // 节点映射
+    POS endPos;
+    SizeT endNodeIdx;
+    JPS_Flags flags;
+    int stepsRemain;
+    SizeT stepsDone;
+    MemBudget mem;
+    // 移动目标模式（JPS_Flag_MovingTarget）。
+    // 学到的值按Lazy的方式修正：保存h + mtShift，使用时减去当前的mtShift。
+    ScoreMapT<POS> hmem;  // 学到的启发式
+    POS mtGoal;           // 学到的值对应的目标
+    ScoreType mtShift;    // 目标移动的累计修正
+    SearcherBaseT(void* user, const POS& invalid)
+        : storage(user),
+          open(storage),
+          nodemap(storage),
+          endPos(invalid),
+          endNodeIdx(noidx),
+          flags(0),
+          stepsRemain(0),
+          stepsDone(0),
+          hmem(user),
+          mtGoal(invalid),
+          mtShift(0) {
+    }
+    void clear() {
+        const SizeT used = storage.size();
+        open.clear();
+        nodemap.clear();
+        storage.clear();
+        endNodeIdx = noidx;
+        stepsDone = 0;
+        if (const SizeT keep = mem.decay(used, storage.capacity()))
+            _shrink(keep);
+    }
+    void _shrink(SizeT n) {
+        open._shrink(n);
+        nodemap._shrink(n);
+        storage._shrink(n);
+    }
+    // 查找或创建节点，创建时遵守内存限制（已有的节点不需要内存，总是可以找到）
+    inline NODE* _getNode(const POS& pos) {
+        if (mem.limit) {
+            if (const NODE* n = nodemap.find(pos))
+                return const_cast<NODE*>(n);
+            const SizeT bytes = storage._nextMemSize() + nodemap._nextMemSize() + open._nextMemSize();
+            if (bytes + hmem._getMemSize() > mem.limit && hmem._getMemSize()) {
+                // 搜索优先：丢弃学到的启发式。剩下的节点只用估计值，仍然是可接受的。
+                hmem.dealloc();
+                _mtReset();
+            }
+            if (!mem.allow(bytes))
+                return 0;
+        }
+        return nodemap(pos);
+    }
+    // 交换全部搜索状态和内存。open和nodemap始终绑定在自己的storage上，所以三者一起交换。
+    void _swapState(SearcherBaseT& o) {
+        storage._swap(o.storage);
+        open._swap(o.open);
+        nodemap._swap(o.nodemap);
+        Swap(endPos, o.endPos);
+        Swap(endNodeIdx, o.endNodeIdx);
+        Swap(flags, o.flags);
+        Swap(stepsRemain, o.stepsRemain);
+        Swap(stepsDone, o.stepsDone);
+        Swap(mem, o.mem);
+        hmem._swap(o.hmem);
+        Swap(mtGoal, o.mtGoal);
+        Swap(mtShift, o.mtShift);
+    }
+    // 到目标的启发式：在移动目标模式中是估计值和学到的值中较大的一个
+    template <typename POLICY>
+    inline ScoreType _heuristic(const POS& p, const POS& goal) const {
+        ScoreType h = POLICY::Estimate(p, goal);
+        ScoreType v;
+        if ((POLICY::Flags(flags) & JPS_Flag_MovingTarget) && hmem.get(p, v))
+            h = Max(h, v - mtShift);
+        return h;
+    }
+    // 在findPathInit()中clear()之前调用：如果上一次搜索是移动目标搜索并且找到了路径
+    // （通过A*，而不是贪婪检查），它的已关闭节点s学到 h(s) = 路径代价 - g(s)。
+    // 这不大于s到目标的真实距离，因为路径代价是最优的，而g(s)不小于从起点到s的距离。
+    template <typename POLICY>
+    void _mtLearn() {
+        // mtGoal在resetMovingTarget()之后无效，这时不能从上一次搜索学习
+        if (!(POLICY::Flags(flags) & JPS_Flag_MovingTarget) || endNodeIdx == noidx || !storage[endNodeIdx].isClosed()
+            || endPos != mtGoal)
+            return;
+        const ScoreType cost = storage[endNodeIdx].g;
+        const SizeT n = storage.size();
+        const SizeT nodeMem = storage._getMemSize() + nodemap._getMemSize() + open._getMemSize();
+        for (SizeT i = 0; i < n; ++i) {
+            const NODE& nd = storage[i];
+            const ScoreType v = cost - nd.g + mtShift;
+            ScoreType old;
+            if (nd.isClosed() && (!hmem.get(nd.pos, old) || old < v)) {
+                if (mem.limit && nodeMem + hmem._nextMemSize() > mem.limit)
+                    break;  // 不超出内存限制，只是学到的更少
+                if (!hmem.set(nd.pos, v))
+                    break;  // 内存不足，只是学到的更少
+            }
+        }
+    }
+    // 目标从g移动到g'。moveCost是g'到g的路径代价的上界，< 0表示未知。
+    // h(s) <= d(s, g) <= d(s, g') + d(g', g)，所以h(s) - moveCost对新目标仍然是可接受的。
+    // 所有学到的值减去同样的量，所以只需要累加到mtShift。
+    void _mtMoveGoal(const POS& end, ScoreType moveCost) {
+        if (mtGoal.isValid() && end != mtGoal) {
+            if (moveCost < 0)
+                _mtReset();
+            else
+                mtShift += moveCost;
+        }
+        mtGoal = end;
+    }
+    void _mtReset() {
+        hmem.clear();
+        mtGoal.x = PosType(-1);  // 无效
+        mtShift = 0;
+    }
+    // 扩展节点，思路是：
+    // 1. 计算额外代价
+    // 2. 计算新代价
+    // 3. 如果节点不在开放列表中，或者新代价小于节点代价，则更新节点
+    // 4. 如果节点不在开放列表中，则将节点加入开放列表
+    // 5. 如果节点在开放列表中，则更新节点，更新之后会影响其他节点
+    // 参数：
+    // jp: 目标位置
+    // jn: 目标节点
+    // parent: 父节点
+    template <typename POLICY>
+    void _expandNode(const POS jp, NODE& jn, const NODE& parent) {
+        JPS_ASSERT(jn.pos == jp);                               // 确保节点是正确的
+        ScoreType extraG = POLICY::Accurate(jp, parent.pos);    // 计算额外代价
+        ScoreType newG = parent.g + extraG;                         // 计算新代价
+        if (!jn.isOpen() || newG < jn.g) {  // 如果节点不在开放列表中，或者新代价小于节点代价，则更新节点
+            jn.g = newG;                    // 更新节点代价
+            jn.f = jn.g + _heuristic<POLICY>(jp, endPos);  // 计算新f值
+            jn.setParent(parent);                              // 设置父节点
+            if (!jn.isOpen()) {      // 如果节点不在开放列表中，则将节点加入开放列表
+                open.pushNode(&jn);  // 将节点加入开放列表
+                jn.setOpen();        // 设置节点为开放
+            } else if (jn.isClosed()) {
+                // 只在移动目标模式中：学到的启发式不一定一致，所以已关闭的节点找到更短的路径时重新打开
+                jn.reopen();
+                open.pushNode(&jn);
+            } else
+                open.fixNode(jn);  // 如果节点在开放列表中，则更新节点
+        }
+    }
+public:
+    void freeMemory() {
+        open.dealloc();
+        nodemap.dealloc();
+        storage.dealloc();
+        endNodeIdx = noidx;
+        mem.watermark = 0;
+        hmem.dealloc();
+        _mtReset();
+    }
+    // 忘记移动目标模式学到的启发式（地图改变之后必须调用）
+    void resetMovingTarget() {
+        _mtReset();
+    }
+    // 内存上限（字节），0 = 无限制。见MemBudget。
+    inline void setMemoryLimit(SizeT bytes) {
+        mem.limit = bytes;
+    }
+    inline SizeT getMemoryLimit() const {
+        return mem.limit;
+    }
+    // 在偶尔的大搜索之后自动缩小内存，见MemBudget
+    inline void setAutoShrink(bool on) {
+        mem.autoShrink = on;
+    }
+    // --- Statistics ---
+    inline SizeT getStepsDone() const {
+        return stepsDone;
+    }
+    inline SizeT getNodesExpanded() const {
+        return storage.size();
+    }
+    SizeT getTotalMemoryInUse() const {
+        return storage._getMemSize() + nodemap._getMemSize() + open._getMemSize() + hmem._getMemSize();
+    }
+    // --- 找到路径之后 ---
+    // findPathFinish()会添加的位置数量，没有路径时为0
+    inline SizeT getPathLength(unsigned step) const {
+        return PathLength(storage, endNodeIdx, step);
+    }
+    // 把路径写进调用者的缓冲区，不分配内存。返回路径长度；如果cap小于它，什么也不写。
+    SizeT writePath(POS* out, SizeT cap, unsigned step) const {
+        const SizeT len = getPathLength(step);
+        if (len && len <= cap)
+            WritePathBackwards(storage, endNodeIdx, out + len, step);
+        return len;
+    }
+};
+// floodRange()使用的策略：和POLICY相同，但没有启发式（Dijkstra），也不使用移动目标模式
+template <typename POLICY>
+struct RangePolicy : public POLICY {
+    static inline JPS_Flags Flags(JPS_Flags runtimeFlags) {
+        return POLICY::Flags(runtimeFlags) & ~JPS_Flag_MovingTarget;
+    }
+    template <typename POS>
+    static inline ScoreType Estimate(const POS&, const POS&) {
+        return 0;
+    }
+};
+// floodRange()的位集输出，覆盖可达格子的外接矩形。
+// operator()的形式和网格一样，所以也可以用作只允许在范围内移动的网格。
+class RangeBits {
+public:
+    RangeBits(void* user = 0) : _bits(user), _x(0), _y(0), _w(0), _h(0) {
+    }
+    inline bool operator()(PosType x, PosType y) const {
+        x -= _x;  // 无符号，左侧或上方的位置变成很大的数
+        y -= _y;
+        if (x >= _w || y >= _h)
+            return false;
+        const SizeT i = SizeT(y) * _w + x;
+        return (_bits[i >> 5] >> (i & 31)) & 1;
+    }
+    // 外接矩形，没有格子时宽高为0
+    inline PosType getX() const {
+        return _x;
+    }
+    inline PosType getY() const {
+        return _y;
+    }
+    inline PosType getWidth() const {
+        return _w;
+    }
+    inline PosType getHeight() const {
+        return _h;
+    }
+    void clear() {
+        _bits.clear();
+        _w = _h = 0;
+    }
+    void dealloc() {
+        _bits.dealloc();
+        _w = _h = 0;
+    }
+    SizeT _getMemSize() const {
+        return _bits._getMemSize();
+    }
+    // 设置为存储中所有节点的位置
+    template <typename NODE>
+    bool _build(const PodVec<NODE>& storage) {
+        clear();
+        const SizeT n = storage.size();
+        if (!n)
+            return true;
+        PosType x0 = storage[0].pos.x, y0 = storage[0].pos.y, x1 = x0, y1 = y0;
+        for (SizeT i = 1; i < n; ++i) {
+            const Position& p = storage[i].pos;
+            x0 = Min(x0, p.x);
+            y0 = Min(y0, p.y);
+            x1 = Max(x1, p.x);
+            y1 = Max(y1, p.y);
+        }
+        const SizeT words = ((SizeT(x1 - x0) + 1) * (SizeT(y1 - y0) + 1) + 31) / 32;
+        _bits.resize(words);
+        if (_bits.size() != words)
+            return false;
+        unsigned* const bits = _bits.data();
+        for (SizeT i = 0; i < words; ++i)
+            bits[i] = 0;
+        _x = x0;
+        _y = y0;
+        _w = x1 - x0 + 1;
+        _h = y1 - y0 + 1;
+        for (SizeT i = 0; i < n; ++i) {
+            const SizeT k = SizeT(storage[i].pos.y - y0) * _w + (storage[i].pos.x - x0);
+            bits[k >> 5] |= 1u << (k & 31);
+        }
+        return true;
+    }
+private:
+    PodVec<unsigned> _bits;
+    PosType _x, _y, _w, _h;
+    RangeBits(const RangeBits&);
+    RangeBits& operator=(const RangeBits&);
+};
+class SearcherBase : public SearcherBaseT<Node> {
+protected:
+    SearcherBase(void* user) : SearcherBaseT<Node>(user, npos) {
+    }
+public:
+    template <typename PV>
+    JPS_Result generatePath(PV& path, unsigned step) const;
+};
+template <typename GRID, typename POLICY = DefaultPolicy>
+class Searcher : public SearcherBase {
+public:
+    Searcher(const GRID& g, void* user = 0) : SearcherBase(user), grid(g), model(0) {
+    }
+#if JPS_HAS_MOVE
+    Searcher(Searcher&& o) : SearcherBase(o.storage._user), grid(o.grid), model(0) {
+        swap(o);
+    }
+    Searcher& operator=(Searcher&& o) {
+        swap(o);
+        return *this;
+    }
+#endif
+    // 改用另一个网格，保留已分配的内存。中止正在进行的搜索。
+    void rebind(const GRID& g) {
+        grid = GridRef<GRID>(g);
+        clear();
+        _mtReset();
+    }
+    inline const GRID& getGrid() const {
+        return grid.get();
+    }
+    // JPS_Flag_AutoSelect使用的模型（0 = 无）。模型必须在使用期间保持有效。
+    inline void setEngineModel(const EngineModel* m) {
+        model = m;
+    }
+    inline const EngineModel* getEngineModel() const {
+        return model;
+    }
+    // 交换网格、模型、搜索状态和内存
+    void swap(Searcher& o) {
+        _swapState(o);
+        Swap(grid, o.grid);
+        Swap(model, o.model);
+    }
+    // 单次调用
+    template <typename PV>
+    bool findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags = JPS_Flag_Default);
+    // 增量路径查找
+    JPS_Result findPathInit(Position start, Position end, JPS_Flags flags = JPS_Flag_Default);
+    JPS_Result findPathStep(int limit);
+    // 生成路径，在找到路径后
+    template <typename PV>
+    JPS_Result findPathFinish(PV& path, unsigned step) const;
+    // 可达范围：从start出发代价（JPS_HEURISTIC_ACCURATE）不大于maxCost的所有格子，包括start。
+    // 一次有界的Dijkstra（总是逐格扩展，忽略JPS_Flag_AStarOnly和贪婪检查），
+    // 代替对范围内每个格子调用findPath()。使用和findPath()相同的节点存储和内存限制。
+    // 格子追加到out（顺序不确定），或者写入位集。start不可行走或内存不足时返回false。
+    template <typename PV>
+    bool floodRange(PV& out, Position start, ScoreType maxCost, JPS_Flags flags = JPS_Flag_Default);
+    bool floodRange(RangeBits& out, Position start, ScoreType maxCost, JPS_Flags flags = JPS_Flag_Default);
+    // 在floodRange()之后（下一次搜索之前）：到范围内某个格子的代价和路径
+    bool getRangeCost(Position p, ScoreType& cost) const;
+    template <typename PV>
+    bool getRangePath(PV& path, Position p, unsigned step) const;
+    // 策略钩子（见DefaultPolicy）使用的内置实现
+    inline unsigned _findNeighbors(const Node& n, Position* w) {
+        return (_flags() & JPS_Flag_AStarOnly) ? findNeighborsAStar(n, w) : findNeighborsJPS(n, w);
+    }
+    inline Position _jump(const Position& p, const Position& src) {
+        return jumpP(p, src);
+    }
+    inline bool _findPathGreedy(Node* start, Node* end) {
+        return findPathGreedy(start, end);
+    }
+    inline const Position& _getEndPos() const {
+        return endPos;
+    }
+private:
+    GridRef<GRID> grid;
+    const EngineModel* model;
+    // 实际使用的标志；固定策略下是编译时常量
+    inline JPS_Flags _flags() const {
+        return POLICY::Flags(flags);
+    }
+    Node* getNode(const Position& pos);
+    bool identifySuccessors(const Node& n);
+    bool findPathGreedy(Node* start, Node* end);
+    bool findDirectPath(const Position& start, const Position& endpos, Position& midpos) const;
+    JPS_Result flood(Position start, ScoreType maxCost, JPS_Flags flags);
     unsigned findNeighborsAStar(const Node& n, Position* wptr);
     unsigned findNeighborsJPS(const Node& n, Position* wptr) const;
     Position jumpP(const Position& p, const Position& src);
     Position jumpD(Position p, int dx, int dy);
     Position jumpX(Position p, int dx);
     Position jumpY(Position p, int dy);
+    // 4方向模式（JPS_Flag_FourConnected）
+    unsigned findNeighborsJPS4(const Node& n, Position* wptr) const;
+    unsigned findNeighborsAStar4(const Node& n, Position* wptr);
+    Position jumpH4(Position p, int dx);
+    Position jumpV4(Position p, int dy);
+    bool isLineWalkable(PosType x, PosType y, PosType tx, PosType ty) const;
     // 禁止任何操作
-    Searcher& operator=(const Searcher<GRID>&);
-    Searcher(const Searcher<GRID>&);
+    Searcher& operator=(const Searcher&);
+    Searcher(const Searcher&);
 };
 // -----------------------------------------------------------------------
-template <typename PV>
-JPS_Result SearcherBase::generatePath(PV& path, unsigned step) const {
-    if (endNodeIdx == noidx)
-        return JPS_NO_PATH;
+// 从目标节点沿父节点回溯生成路径（2D、3D和WeightedSearcher共用）
+template <typename NODE, typename PV>
+JPS_Result GeneratePath(const PodVec<NODE>& storage, SizeT endNodeIdx, PV& path, unsigned step) {
+    const SizeT len = PathLength(storage, endNodeIdx, step);
+    if (!len)
+        return JPS_NO_PATH;  // 没有找到路径，或者目标节点没有父节点
     const SizeT offset = path.size();
-    SizeT added = 0;
-    const Node& endNode = storage[endNodeIdx];
-    const Node* next = &endNode; // 获取目标节点
-    if (!next->hasParent())
-        return JPS_NO_PATH; // 如果目标节点没有父节点，则返回没有路径
-    if (step) {
-        const Node* prev = endNode.getParentOpt();
-        if (!prev)
-            return JPS_NO_PATH; // 如果目标节点没有父节点，则返回没有路径
-        do {
-            const unsigned x = next->pos.x, y = next->pos.y;
-            int dx = int(prev->pos.x - x);
-            int dy = int(prev->pos.y - y);
-            const int adx = Abs(dx);
-            const int ady = Abs(dy);
-            JPS_ASSERT(!dx || !dy || adx == ady);  // 已知为直线，如果对角线
-            const int steps = Max(adx, ady);
-            dx = int(step) * Sgn(dx);
-            dy = int(step) * Sgn(dy);
-            int dxa = 0, dya = 0;
-            for (int i = 0; i < steps; i += step) {
-                path.push_back(Pos(x + dxa, y + dya));
-                ++added;
-                dxa += dx;
-                dya += dy;
-            }
-            next = prev;
-            prev = prev->getParentOpt();
-        } while (prev);
-    } else {
-        do {
-            JPS_ASSERT(next != &next->getParent());
-            path.push_back(next->pos);
-            ++added;
-            next = &next->getParent();
-        } while (next->hasParent());
-    }
-
-    // JPS::PathVector默默地丢弃push_back()，当内存分配失败时；
-    // 检测这种情况并回滚。
-    if (path.size() != offset + added) {
+    path.resize(offset + len);
+    // JPS::PathVector在内存分配失败时默默地不改变大小；检测这种情况并回滚。
+    if (path.size() != offset + len) {
         path.resize(offset);
         return JPS_OUT_OF_MEMORY;
     }
-
-    // 节点被反向遍历，修复
-    Reverse(path.begin() + offset, path.end());
+    WritePathBackwards(storage, endNodeIdx, path.end(), step);
     return JPS_FOUND_PATH;
 }
+template <typename PV>
+JPS_Result SearcherBase::generatePath(PV& path, unsigned step) const {
+    return GeneratePath(storage, endNodeIdx, path, step);
+}
 //-----------------------------------------
-template <typename GRID>
-inline Node* Searcher<GRID>::getNode(const Position& pos) {
+template <typename GRID, typename POLICY>
+inline Node* Searcher<GRID, POLICY>::getNode(const Position& pos) {
     JPS_ASSERT(grid(pos.x, pos.y));
-    return nodemap(pos.x, pos.y);
+    return this->_getNode(pos);
 }
 
 // 跳跃到目标位置
-template <typename GRID>
-Position Searcher<GRID>::jumpP(const Position& p, const Position& src) {
+template <typename GRID, typename POLICY>
+Position Searcher<GRID, POLICY>::jumpP(const Position& p, const Position& src) {
     JPS_ASSERT(grid(p.x, p.y));
     int dx = int(p.x - src.x);
     int dy = int(p.y - src.y);
     JPS_ASSERT(dx || dy);
+    if (_flags() & JPS_Flag_FourConnected) {
+        JPS_ASSERT(!dx || !dy);
+        return dx ? jumpH4(p, dx) : jumpV4(p, dy);
+    }
     if (dx && dy)
         return jumpD(p, dx, dy); // 跳跃对角线
     else if (dx)
@@ -874,8 +2033,8 @@ Position Searcher<GRID>::jumpP(const Position& p, const Position& src) {
 }
 
 // 跳跃对角线
-template <typename GRID>
-Position Searcher<GRID>::jumpD(Position p, int dx, int dy) {
+template <typename GRID, typename POLICY>
+Position Searcher<GRID, POLICY>::jumpD(Position p, int dx, int dy) {
     JPS_ASSERT(grid(p.x, p.y)); // 确保中间位置有效
     JPS_ASSERT(dx && dy);
     const Position endpos = endPos;
@@ -892,222 +2051,1932 @@ Position Searcher<GRID>::jumpD(Position p, int dx, int dy) {
         const bool gdy = !!grid(x, y + dy); // 获取中间位置的x坐标和y坐标是否有效
         if (gdx && jumpX(Pos(x + dx, y), dx).isValid()) // 如果中间位置的x坐标和y坐标满足条件，跳出循环
             break;
-        if (gdy && jumpY(Pos(x, y + dy), dy).isValid())
+        if (gdy && jumpY(Pos(x, y + dy), dy).isValid())
+            break;
+        if ((gdx || gdy) && grid(x + dx, y + dy)) {
+            p.x += dx;
+            p.y += dy;
+        } else {
+            p = npos;
+            break;
+        }
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+// 跳跃x轴
+template <typename GRID, typename POLICY>
+inline Position Searcher<GRID, POLICY>::jumpX(Position p, int dx) {
+    JPS_ASSERT(dx);
+    JPS_ASSERT(grid(p.x, p.y));
+    const PosType y = p.y;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+    unsigned a = ~((!!grid(p.x, y + 1)) | ((!!grid(p.x, y - 1)) << 1));
+    while (true) {
+        const unsigned xx = p.x + dx;
+        const unsigned b = (!!grid(xx, y + 1)) | ((!!grid(xx, y - 1)) << 1);
+        if ((b & a) || p == endpos)
+            break;
+        if (!grid(xx, y)) {
+            p = npos;
+            break;
+        }
+        p.x += dx;
+        a = ~b;
+        ++steps;
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+// 跳跃y轴
+template <typename GRID, typename POLICY>
+inline Position Searcher<GRID, POLICY>::jumpY(Position p, int dy) {
+    JPS_ASSERT(dy);
+    JPS_ASSERT(grid(p.x, p.y));
+    const PosType x = p.x;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+    unsigned a = ~((!!grid(x + 1, p.y)) | ((!!grid(x - 1, p.y)) << 1));
+    while (true) {
+        const unsigned yy = p.y + dy;
+        const unsigned b = (!!grid(x + 1, yy)) | ((!!grid(x - 1, yy)) << 1);
+        if ((a & b) || p == endpos)
+            break;
+        if (!grid(x, yy)) {
+            p = npos;
+            break;
+        }
+        p.y += dy;
+        a = ~b;
+        ++steps;
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+// 4方向模式：水平跳跃。
+// 没有对角线，所以强制邻居就在当前格子的上下方：(x, y+s)可行走而上一个格子的(x-dx, y+s)被阻挡。
+// 与jumpX不同，跳跃停在当前格子本身，而不是它的前一个格子。
+template <typename GRID, typename POLICY>
+Position Searcher<GRID, POLICY>::jumpH4(Position p, int dx) {
+    JPS_ASSERT(dx);
+    JPS_ASSERT(grid(p.x, p.y));
+    const PosType y = p.y;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+    unsigned a = ~((!!grid(p.x - dx, y + 1)) | ((!!grid(p.x - dx, y - 1)) << 1));
+    while (true) {
+        const unsigned b = (!!grid(p.x, y + 1)) | ((!!grid(p.x, y - 1)) << 1);
+        if ((a & b) || p == endpos)
+            break;
+        ++steps;
+        if (!grid(p.x + dx, y)) {
+            p = npos;
+            break;
+        }
+        p.x += dx;
+        a = ~b;
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+
+// 4方向模式：垂直跳跃。
+// 左右两侧都是自然邻居，所以每一步都要向两侧做水平跳跃（类似jumpD中的直线跳跃）。
+template <typename GRID, typename POLICY>
+Position Searcher<GRID, POLICY>::jumpV4(Position p, int dy) {
+    JPS_ASSERT(dy);
+    JPS_ASSERT(grid(p.x, p.y));
+    const Position endpos = endPos;
+    unsigned steps = 0;
+    while (true) {
+        if (p == endpos)
+            break;
+        ++steps;
+        const PosType x = p.x;
+        const PosType y = p.y;
+        if (grid(x + 1, y) && jumpH4(Pos(x + 1, y), 1).isValid())
+            break;
+        if (grid(x - 1, y) && jumpH4(Pos(x - 1, y), -1).isValid())
+            break;
+        if (!grid(x, y + dy)) {
+            p = npos;
+            break;
+        }
+        p.y += dy;
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+#define JPS_CHECKGRID(dx, dy) (grid(x + (dx), y + (dy)))
+
+// 添加邻居
+#define JPS_ADDPOS(dx, dy)              \
+    do {                                \
+        *w++ = Pos(x + (dx), y + (dy)); \
+    } while (0)
+
+// 添加邻居，防止穿墙
+#define JPS_ADDPOS_CHECK(dx, dy)   \
+    do {                           \
+        if (JPS_CHECKGRID(dx, dy)) \
+            JPS_ADDPOS(dx, dy);    \
+    } while (0)
+
+// 添加邻居，防止穿墙
+#define JPS_ADDPOS_NO_TUNNEL(dx, dy)                \
+    do {                                            \
+        if (grid(x + (dx), y) || grid(x, y + (dy))) \
+            JPS_ADDPOS_CHECK(dx, dy);               \
+    } while (0)
+
+// 返回邻居数量
+template <typename GRID, typename POLICY>
+unsigned Searcher<GRID, POLICY>::findNeighborsJPS(const Node& n, Position* wptr) const {
+    Position* w = wptr;
+    const unsigned x = n.pos.x;
+    const unsigned y = n.pos.y;
+    if (!n.hasParent()) {
+        if (_flags() & JPS_Flag_FourConnected)
+            return findNeighborsJPS4(n, wptr);
+        // straight moves
+        JPS_ADDPOS_CHECK(-1, 0); // 添加左邻居
+        JPS_ADDPOS_CHECK(0, -1); // 添加上邻居
+        JPS_ADDPOS_CHECK(0, 1); // 添加右邻居
+        JPS_ADDPOS_CHECK(1, 0); // 添加下邻居
+        // diagonal moves + prevent tunneling
+        JPS_ADDPOS_NO_TUNNEL(-1, -1); // 添加左上角邻居
+        JPS_ADDPOS_NO_TUNNEL(-1, 1); // 添加左下角邻居
+        JPS_ADDPOS_NO_TUNNEL(1, -1); // 添加右上角邻居
+        JPS_ADDPOS_NO_TUNNEL(1, 1); // 添加右下角邻居
+        return unsigned(w - wptr);
+    }
+    if (_flags() & JPS_Flag_FourConnected)
+        return findNeighborsJPS4(n, wptr);
+    const Node& p = n.getParent(); // 获取父节点
+    // jump directions (both -1, 0, or 1)
+    const int dx = Sgn<int>(x - p.pos.x); // 计算x轴方向
+    const int dy = Sgn<int>(y - p.pos.y); // 计算y轴方向
+    if (dx && dy) { // 如果x轴和y轴方向都存在
+        // 对角线方向
+        // 自然邻居
+        const bool walkX = !!grid(x + dx, y); // 判断x轴方向是否可行走
+        if (walkX)
+            *w++ = Pos(x + dx, y); // 添加x轴方向的邻居
+        const bool walkY = !!grid(x, y + dy); // 判断y轴方向是否可行走
+        if (walkY)
+            *w++ = Pos(x, y + dy); // 添加y轴方向的邻居
+        if (walkX || walkY)
+            JPS_ADDPOS_CHECK(dx, dy); // 添加对角线方向的邻居
+        // 强制邻居
+        if (walkY && !JPS_CHECKGRID(-dx, 0))
+            JPS_ADDPOS_CHECK(-dx, dy);
+        if (walkX && !JPS_CHECKGRID(0, -dy))
+            JPS_ADDPOS_CHECK(dx, -dy);
+    } else if (dx) {
+        // 沿x轴
+        if (JPS_CHECKGRID(dx, 0)) {
+            JPS_ADDPOS(dx, 0);
+            // 强制邻居（+防止穿墙）
+            if (!JPS_CHECKGRID(0, 1))
+                JPS_ADDPOS_CHECK(dx, 1);
+            if (!JPS_CHECKGRID(0, -1))
+                JPS_ADDPOS_CHECK(dx, -1);
+        }
+    } else if (dy) {
+        // 沿y轴
+        if (JPS_CHECKGRID(0, dy)) {
+            JPS_ADDPOS(0, dy);
+            // 强制邻居（+防止穿墙）
+            if (!JPS_CHECKGRID(1, 0))
+                JPS_ADDPOS_CHECK(1, dy);
+            if (!JPS_CHECKGRID(-1, 0))
+                JPS_ADDPOS_CHECK(-1, dy);
+        }
+    }
+    return unsigned(w - wptr);
+}
+// 4方向模式的邻居：
+// 水平移动时只有前方是自然邻居，上下方在上一个格子被阻挡时是强制邻居；
+// 垂直移动时前方和左右两侧都是自然邻居。
+template <typename GRID, typename POLICY>
+unsigned Searcher<GRID, POLICY>::findNeighborsJPS4(const Node& n, Position* wptr) const {
+    Position* w = wptr;
+    const unsigned x = n.pos.x;
+    const unsigned y = n.pos.y;
+    if (!n.hasParent()) {
+        JPS_ADDPOS_CHECK(-1, 0);
+        JPS_ADDPOS_CHECK(0, -1);
+        JPS_ADDPOS_CHECK(0, 1);
+        JPS_ADDPOS_CHECK(1, 0);
+        return unsigned(w - wptr);
+    }
+    const Node& p = n.getParent();
+    const int dx = Sgn<int>(x - p.pos.x);
+    const int dy = Sgn<int>(y - p.pos.y);
+    JPS_ASSERT(!dx || !dy);
+    if (dx) {
+        JPS_ADDPOS_CHECK(dx, 0);
+        // 强制邻居
+        if (!JPS_CHECKGRID(-dx, 1))
+            JPS_ADDPOS_CHECK(0, 1);
+        if (!JPS_CHECKGRID(-dx, -1))
+            JPS_ADDPOS_CHECK(0, -1);
+    } else if (dy) {
+        JPS_ADDPOS_CHECK(0, dy);
+        JPS_ADDPOS_CHECK(1, 0);
+        JPS_ADDPOS_CHECK(-1, 0);
+    }
+    return unsigned(w - wptr);
+}
+//-------------- Plain old A* search ----------------
+template <typename GRID, typename POLICY>
+unsigned Searcher<GRID, POLICY>::findNeighborsAStar(const Node& n, Position* wptr) {
+    if (_flags() & JPS_Flag_FourConnected)
+        return findNeighborsAStar4(n, wptr);
+    Position* w = wptr;
+    const int x = n.pos.x;
+    const int y = n.pos.y;
+    const int d = 1;
+    JPS_ADDPOS_NO_TUNNEL(-d, -d); // 添加左上角邻居
+    JPS_ADDPOS_CHECK(0, -d); // 添加正上方邻居  
+    JPS_ADDPOS_NO_TUNNEL(+d, -d); // 添加右上角邻居
+    JPS_ADDPOS_CHECK(-d, 0); // 添加左方邻居
+    JPS_ADDPOS_CHECK(+d, 0); // 添加右方邻居
+    JPS_ADDPOS_NO_TUNNEL(-d, +d); // 添加左下角邻居
+    JPS_ADDPOS_CHECK(0, +d); // 添加正下方邻居
+    JPS_ADDPOS_NO_TUNNEL(+d, +d); // 添加右下角邻居
+    stepsDone += 8; // 步数加8
+    return unsigned(w - wptr); // 返回邻居数量
+}
+template <typename GRID, typename POLICY>
+unsigned Searcher<GRID, POLICY>::findNeighborsAStar4(const Node& n, Position* wptr) {
+    Position* w = wptr;
+    const int x = n.pos.x;
+    const int y = n.pos.y;
+    JPS_ADDPOS_CHECK(0, -1);
+    JPS_ADDPOS_CHECK(-1, 0);
+    JPS_ADDPOS_CHECK(+1, 0);
+    JPS_ADDPOS_CHECK(0, +1);
+    stepsDone += 4;
+    return unsigned(w - wptr);
+}
+//-------------------------------------------------
+#undef JPS_ADDPOS
+#undef JPS_ADDPOS_CHECK
+#undef JPS_ADDPOS_NO_TUNNEL
+#undef JPS_CHECKGRID
+
+// 识别后继节点
+template <typename GRID, typename POLICY>
+bool Searcher<GRID, POLICY>::identifySuccessors(const Node& n_) {
+    const SizeT nidx = storage.getindex(&n_);
+    const Position np = n_.pos;
+    Position buf[8]; // 邻居数组，最多8个邻居
+    const int num = POLICY::Neighbors(*this, n_, &buf[0]); // 获取邻居数量
+    JPS_ASSERT(num <= 8);
+    for (int i = num - 1; i >= 0; --i) {
+        // 不变性：一个节点只有在对应的网格位置是可行走的时才是有效的邻居（在jumpP中被断言）
+        Position jp;
+        if (_flags() & JPS_Flag_AStarOnly)
+            jp = buf[i]; // 如果使用A*算法，则直接使用邻居
+        else {
+            jp = POLICY::Jump(*this, buf[i], np); // 跳跃到目标位置
+            if (!jp.isValid())
+                continue; // 如果跳跃后的位置无效，则跳过
+        }
+        // 现在网格位置肯定是有效的跳点，我们必须创建实际的节点。
+        Node* jn = getNode(jp);  // 这可能会重新分配存储
+        if (!jn)
+            return false;  // 内存不足
+        Node& n = storage[nidx];  // 在重新分配的情况下获取有效的引用
+        JPS_ASSERT(jn != &n);
+        if (!jn->isClosed() || (_flags() & JPS_Flag_MovingTarget))
+            _expandNode<POLICY>(jp, *jn, n);
+    }
+    return true;
+}
+template <typename GRID, typename POLICY>
+template <typename PV>
+bool Searcher<GRID, POLICY>::findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags) {
+    JPS_Result res = findPathInit(start, end, flags);
+    // 如果这是真的，结果路径是空的（findPathFinish()会失败，所以这需要在检查之前）
+    if (res == JPS_EMPTY_PATH)
+        return true;
+    while (true) {
+        switch (res) { 
+            case JPS_NEED_MORE_STEPS:
+                res = findPathStep(0); // 步数不足，继续搜索
+                break;  // 开关
+            case JPS_FOUND_PATH:
+                return findPathFinish(path, step) == JPS_FOUND_PATH;
+            case JPS_EMPTY_PATH:
+                JPS_ASSERT(false);  // can't happen
+                // fall through
+            case JPS_NO_PATH:
+            case JPS_OUT_OF_MEMORY:
+            case JPS_BUDGET_EXCEEDED:
+                return false;
+        }
+    }
+}
+template <typename GRID, typename POLICY>
+JPS_Result Searcher<GRID, POLICY>::findPathInit(Position start, Position end, JPS_Flags flags) {
+    flags = POLICY::Flags(flags);  // 固定策略下是常量，下面的检查在编译时消除
+    if (flags & JPS_Flag_AutoSelect) {
+        flags |= JPS_Flag_RaycastGreedy;
+        if (model)
+            flags |= model->select(start, end);
+    }
+    this->template _mtLearn<POLICY>();  // 需要上一次搜索的节点，所以在clear()之前
+    if (flags & JPS_Flag_MovingTarget) {
+        ScoreType moveCost = -1;
+        Position mid;
+        if (!mtGoal.isValid() || end == mtGoal)
+            moveCost = 0;
+        else if (findDirectPath(end, mtGoal, mid))
+            moveCost = mid.isValid() ? POLICY::Accurate(end, mid) + POLICY::Accurate(mid, mtGoal) : POLICY::Accurate(end, mtGoal);
+        this->_mtMoveGoal(end, moveCost);
+    }
+    // 这仅重置几个计数器；容器内存未触及
+    this->clear();
+    this->flags = flags;
+    endPos = end;
+    // FIXME: 检查这个
+    if (start == end && !(flags & (JPS_Flag_NoStartCheck | JPS_Flag_NoEndCheck))) {
+        // 只有当这个单个位置是可行走的时才有路径。
+        // 但由于起始位置在输出中被省略，这里没有什么可做的。
+        return grid(end.x, end.y) ? JPS_EMPTY_PATH : JPS_NO_PATH;
+    }
+    if (!(flags & JPS_Flag_NoStartCheck)) // 如果不需要检查起始位置
+        if (!grid(start.x, start.y)) // 如果起始位置不可行走
+            return JPS_NO_PATH; // 返回找不到路径
+    if (!(flags & JPS_Flag_NoEndCheck)) // 如果不需要检查目标位置
+        if (!grid(end.x, end.y))
+            return JPS_NO_PATH;
+    Node* endNode = getNode(end);  // 这可能会重新分配内部存储...
+    if (!endNode)
+        return mem.failResult();
+    endNodeIdx = storage.getindex(endNode);  // .. 所以我们保留这个以便稍后使用
+    Node* startNode = getNode(start);  // 这可能会重新分配
+    if (!startNode)
+        return mem.failResult();
+    endNode = &storage[endNodeIdx];  // startNode是有效的，确保endNode也是有效的，以防我们重新分配
+    if (!(flags & JPS_Flag_NoGreedy)) {
+        // 先尝试快速方法
+        if ((flags & JPS_Flag_RaycastGreedy) && !(flags & JPS_Flag_FourConnected) && raycast(grid.get(), start, end)) {
+            endNode->setParent(*startNode);
+            return JPS_FOUND_PATH;
+        }
+        if (POLICY::Greedy(*this, startNode, endNode))
+            return JPS_FOUND_PATH;
+    }
+    startNode->setOpen();  // 移动目标模式中已关闭的节点也会被扩展，起点不能被当作新节点
+    open.pushNode(startNode);
+    return JPS_NEED_MORE_STEPS;
+}
+template <typename GRID, typename POLICY>
+JPS_Result Searcher<GRID, POLICY>::findPathStep(int limit) {
+    stepsRemain = limit;
+    do {
+        if (open.empty())
+            return JPS_NO_PATH;
+        Node& n = open.popNode();
+        n.setClosed();
+        if (n.pos == endPos)
+            return JPS_FOUND_PATH;
+        if (!identifySuccessors(n)) // 识别后继节点
+            return mem.failResult();
+    } while (stepsRemain >= 0);
+    return JPS_NEED_MORE_STEPS;
+}
+template <typename GRID, typename POLICY>
+template <typename PV>
+JPS_Result Searcher<GRID, POLICY>::findPathFinish(PV& path, unsigned step) const {
+    return this->generatePath(path, step);
+}
+template <typename GRID, typename POLICY>
+JPS_Result Searcher<GRID, POLICY>::flood(Position start, ScoreType maxCost, JPS_Flags flags) {
+    typedef RangePolicy<POLICY> RP;
+    this->template _mtLearn<POLICY>();  // 不丢失上一次移动目标搜索的结果
+    this->clear();
+    this->flags = RP::Flags(flags);  // 不从这次搜索学习
+    endPos = npos;
+    if (!(this->flags & JPS_Flag_NoStartCheck) && !grid(start.x, start.y))
+        return JPS_NO_PATH;
+    Node* startNode = getNode(start);
+    if (!startNode)
+        return mem.failResult();
+    startNode->setOpen();  // 移动目标模式中已关闭的节点也会被扩展，起点不能被当作新节点
+    open.pushNode(startNode);
+    Position buf[8];
+    while (!open.empty()) {
+        Node& n_ = open.popNode();
+        n_.setClosed();
+        const SizeT nidx = storage.getindex(&n_);
+        const Position np = n_.pos;
+        const ScoreType g = n_.g;
+        const unsigned num = findNeighborsAStar(n_, &buf[0]);
+        for (unsigned i = 0; i < num; ++i) {
+            // 超出范围的格子不创建节点，所以最后存储中正好是范围内的格子
+            if (g + RP::Accurate(buf[i], np) > maxCost)
+                continue;
+            Node* jn = getNode(buf[i]);
+            if (!jn)
+                return mem.failResult();
+            if (!jn->isClosed())
+                _expandNode<RP>(buf[i], *jn, storage[nidx]);
+        }
+    }
+    return JPS_FOUND_PATH;
+}
+template <typename GRID, typename POLICY>
+template <typename PV>
+bool Searcher<GRID, POLICY>::floodRange(PV& out, Position start, ScoreType maxCost, JPS_Flags flags) {
+    if (flood(start, maxCost, flags) != JPS_FOUND_PATH)
+        return false;
+    const SizeT offset = out.size();
+    const SizeT n = storage.size();
+    out.resize(offset + n);
+    if (out.size() != offset + n) {
+        out.resize(offset);
+        return false;
+    }
+    for (SizeT i = 0; i < n; ++i)
+        out[offset + i] = storage[i].pos;
+    return true;
+}
+template <typename GRID, typename POLICY>
+bool Searcher<GRID, POLICY>::floodRange(RangeBits& out, Position start, ScoreType maxCost, JPS_Flags flags) {
+    out.clear();
+    return flood(start, maxCost, flags) == JPS_FOUND_PATH && out._build(storage);
+}
+template <typename GRID, typename POLICY>
+bool Searcher<GRID, POLICY>::getRangeCost(Position p, ScoreType& cost) const {
+    const Node* n = nodemap.find(p);
+    if (!n || !n->isClosed())
+        return false;
+    cost = n->g;
+    return true;
+}
+template <typename GRID, typename POLICY>
+template <typename PV>
+bool Searcher<GRID, POLICY>::getRangePath(PV& path, Position p, unsigned step) const {
+    const Node* n = nodemap.find(p);
+    if (!n || !n->isClosed())
+        return false;
+    const JPS_Result res = GeneratePath(storage, storage.getindex(n), path, step);
+    return res == JPS_FOUND_PATH || (res == JPS_NO_PATH && !n->hasParent());  // p == start：空路径
+}
+// 从start到endpos是否有直接的路径（先沿对角线再沿直线；4方向模式中是L形）。
+// 有的话midpos是拐点，没有拐点时是npos。
+template <typename GRID, typename POLICY>
+bool Searcher<GRID, POLICY>::findDirectPath(const Position& start, const Position& endpos, Position& midpos) const {
+    midpos = npos;                         // 中间位置
+    PosType x = start.x;                   // 起始位置x
+    PosType y = start.y;                   // 起始位置y
+    JPS_ASSERT(x != endpos.x || y != endpos.y);  // 起始位置和目标位置不能相同
+    int dx = int(endpos.x - x);  // 目标位置x - 起始位置x
+    int dy = int(endpos.y - y);  // 目标位置y - 起始位置y
+    const int adx = Abs(dx);     // 目标位置x - 起始位置x的绝对值
+    const int ady = Abs(dy);     // 目标位置y - 起始位置y的绝对值
+    dx = Sgn(dx);                // 目标位置x - 起始位置x的符号
+    dy = Sgn(dy);                // 目标位置y - 起始位置y的符号
+    if (_flags() & JPS_Flag_FourConnected) {
+        // 只能直线移动：尝试L形路径，先沿x轴再沿y轴，不行再先沿y轴再沿x轴。
+        // 两者的长度都等于曼哈顿距离，所以都是最优的。
+        if (x != endpos.x && y != endpos.y) {
+            if (isLineWalkable(x, y, endpos.x, y) && isLineWalkable(endpos.x, y, endpos.x, endpos.y))
+                midpos = Pos(endpos.x, y);
+            else if (isLineWalkable(x, y, x, endpos.y) && isLineWalkable(x, endpos.y, endpos.x, endpos.y))
+                midpos = Pos(x, endpos.y);
+            else
+                return false;
+        } else if (!isLineWalkable(x, y, endpos.x, endpos.y))
+            return false;
+    } else {
+        // 首先沿对角线移动
+        if (x != endpos.x && y != endpos.y) {
+            JPS_ASSERT(dx && dy);                // 确保dx和dy不为0，为0则表示在同一行或同一列
+            const int minlen = Min(adx, ady);    // 取dx和dy的最小值
+            const PosType tx = x + dx * minlen;  // 计算目标位置x
+            while (x != tx) {
+                if (grid(x, y) && (grid(x + dx, y) || grid(x, y + dy)))  // 防止穿墙
+                {
+                    x += dx;
+                    y += dy;
+                } else
+                    return false;
+            }
+            if (!grid(x, y)) // 如果中间位置不可行走
+                return false; // 返回找不到路径
+            midpos = Pos(x, y); // 设置中间位置
+        }
+        // 此时，我们沿至少一个轴对齐
+        JPS_ASSERT(x == endpos.x || y == endpos.y); // 确保x和y至少有一个等于endpos.x或endpos.y
+        if (!(x == endpos.x && y == endpos.y)) { // 如果x和y不等于endpos.x和endpos.y
+            while (x != endpos.x) // 沿x轴移动
+                if (!grid(x += dx, y)) // 如果移动后的位置不可行走
+                    return false; // 返回找不到路径
+            while (y != endpos.y) // 沿y轴移动
+                if (!grid(x, y += dy))
+                    return false;
+            JPS_ASSERT(x == endpos.x && y == endpos.y);
+        }
+    }
+    return true;
+}
+// 贪心算法
+template <typename GRID, typename POLICY>
+bool Searcher<GRID, POLICY>::findPathGreedy(Node* n, Node* endnode) {
+    JPS_ASSERT(n != endnode);  // 起始节点和目标节点不能相同
+    Position midpos;
+    if (!findDirectPath(n->pos, endnode->pos, midpos))
+        return false;
+    if (midpos.isValid()) { // 如果中间位置有效
+        const unsigned nidx = storage.getindex(n); // 获取中间位置的索引
+        Node* mid = getNode(midpos);  // 获取中间位置的节点
+        if (!mid)
+            return false;
+        n = &storage[nidx];  // 重新加载指针
+        endnode = &storage[endNodeIdx]; // 重新加载目标节点
+        JPS_ASSERT(mid && mid != n); // 确保中间节点和起始节点不同
+        mid->setParent(*n); // 设置中间节点的父节点为起始节点
+        if (mid != endnode) // 如果中间节点不等于目标节点
+            endnode->setParent(*mid); // 设置目标节点的父节点为中间节点
+    } else
+        endnode->setParent(*n); // 如果中间位置无效，设置目标节点的父节点为起始节点
+    return true; // 返回找到路径
+}
+// 检查从(x, y)（不含）到(tx, ty)（含）的水平或垂直线段是否全部可行走
+template <typename GRID, typename POLICY>
+bool Searcher<GRID, POLICY>::isLineWalkable(PosType x, PosType y, PosType tx, PosType ty) const {
+    JPS_ASSERT(x == tx || y == ty);
+    const int dx = Sgn(int(tx - x));
+    const int dy = Sgn(int(ty - y));
+    while (x != tx || y != ty)
+        if (!grid(x += dx, y += dy))
+            return false;
+    return true;
+}
+}  // end namespace Internal
+using Internal::Searcher;
+typedef Internal::PodVec<Position> PathVector;
+typedef StepIteratorT<Position> StepIterator;
+typedef Internal::RangeBits RangeBits;
+// 单次调用便利函数。为了效率，不要在需要重复计算路径时使用这个函数。
+//
+// 返回：0如果失败或无法找到路径，否则为步数。
+//
+// path: 如果函数返回成功，路径将被附加到这个向量中。
+//       路径不包含起始位置，即如果起始位置和结束位置相同，结果路径将没有元素。
+//       向量不必为空。函数不清除它；相反，新路径位置被附加到末尾。
+//       这允许增量构建路径。
+//
+// grid: 仿函数，预期重载operator()(x, y)，如果位置可行走，返回true，否则返回false。
+//
+// step: 如果为0，仅返回路径点。
+//       如果为1，创建详尽的步进路径。
+//       如果为N，将N个块的距离或当到达路径点时放入一个位置。
+//       所有返回的位置都保证在一条直线上（垂直、水平或对角线），并且任何两个连续位置之间没有障碍
+//       （JPS_Flag_RaycastGreedy的路径除外，见那里）。
+//       注意，此参数不会影响路径搜索；它仅控制输出路径的粗细。
+template <typename GRID, typename PV>
+SizeT findPath(PV& path, const GRID& grid, PosType startx, PosType starty, PosType endx, PosType endy,
+               unsigned step = 0,  // optional
+               JPS_Flags flags = JPS_Flag_Default,
+               void* user = 0)  // memory allocation userdata
+{
+    Searcher<GRID> search(grid, user);
+    if (!search.findPath(path, Pos(startx, starty), Pos(endx, endy), step, flags))
+        return 0;
+    const SizeT done = search.getStepsDone();
+    return done + !done;  // report at least 1 step; as 0 would indicate failure
+}
+}  // end namespace JPS
+// ============================
+// ====== 大体积单位（间隙图） ======
+// ============================
+// 占据k x k格子的单位只能站在以该格子为左上角的k x k正方形全部可行走的位置。
+// 与其在GRID仿函数中每次检查k x k个格子（这使每次跳跃扫描的代价乘以k^2），
+// 不如预先计算间隙图：每个格子存储以它为左上角的最大全空正方形的边长（一个字节，上限255）。
+// 然后ClearanceGrid把间隙 >= agentSize的格子视为可行走，Searcher在这个阈值化的网格上照常跳跃，
+// 每次查询只需要一次内存访问，与单位大小无关。
+//   JPS::ClearanceMap cmap;
+//   cmap.build(grid, width, height);  // 地图改变时重新计算
+//   JPS::ClearanceGrid big(cmap, 3);   // 3x3的单位
+//   JPS::Searcher<JPS::ClearanceGrid> search(big);
+//   search.findPath(path, start, end, step);  // 位置是单位的左上角
+// 间隙数据也可以来自其他地方（例如预先计算并保存在文件中），见ClearanceGrid的第二个构造函数。
+namespace JPS {
+class ClearanceMap {
+public:
+    ClearanceMap(void* user = 0) : w(0), h(0), data(user) {
+    }
+    // 从任何2D GRID仿函数计算。内存不足时返回false。
+    // 从右下角开始动态规划：c(x, y) = grid(x, y) ? 1 + min(c(x+1, y), c(x, y+1), c(x+1, y+1)) : 0
+    template <typename GRID>
+    bool build(const GRID& grid, PosType width, PosType height) {
+        data.clear();
+        data.resize(width * height);
+        if (data.size() != width * height) {
+            w = h = 0;
+            return false;
+        }
+        w = width;
+        h = height;
+        for (PosType y = height; y-- > 0;) {
+            unsigned char* row = &data[y * width];
+            const unsigned char* below = y + 1 < height ? row + width : 0;
+            for (PosType x = width; x-- > 0;) {
+                unsigned c = 0;
+                if (grid(x, y)) {
+                    if (below && x + 1 < width)
+                        c = Min<unsigned>(Min<unsigned>(row[x + 1], below[x]), below[x + 1]);
+                    c = Min<unsigned>(c + 1, 255);
+                }
+                row[x] = (unsigned char)c;
+            }
+        }
+        return true;
+    }
+    // 以(x, y)为左上角的最大全空正方形的边长，越界时为0
+    inline unsigned operator()(PosType x, PosType y) const {
+        return x < w && y < h ? data[y * w + x] : 0;
+    }
+    inline PosType width() const {
+        return w;
+    }
+    inline PosType height() const {
+        return h;
+    }
+    inline const unsigned char* getData() const {
+        return data.data();
+    }
+    SizeT _getMemSize() const {
+        return data._getMemSize();
+    }
+private:
+    PosType w, h;
+    Internal::PodVec<unsigned char> data;
+};
+// 把间隙数据阈值化为可行走/不可行走的GRID仿函数。不拥有数据。
+class ClearanceGrid {
+public:
+    // 每次查询都通过m读取数据和大小，所以m.build()之后（即使大小改变）不需要重新构造
+    ClearanceGrid(const ClearanceMap& m, unsigned agentSize = 1)
+        : map(&m), cl(0), w(0), h(0), size(agentSize) {
+    }
+    // data：width * height个字节，按行存储，含义与ClearanceMap相同
+    ClearanceGrid(const unsigned char* data, PosType width, PosType height, unsigned agentSize = 1)
+        : map(0), cl(data), w(width), h(height), size(agentSize) {
+    }
+    // 可以在两次寻路之间改变（不要在增量寻路的过程中改变）
+    inline void setAgentSize(unsigned agentSize) {
+        size = agentSize;
+    }
+    inline unsigned getAgentSize() const {
+        return size;
+    }
+    inline bool operator()(PosType x, PosType y) const {
+        if (map)
+            return (*map)(x, y) >= size;  // 越界时为0，size至少为1
+        return x < w && y < h && cl[y * w + x] >= size;
+    }
+private:
+    const ClearanceMap* map;
+    const unsigned char* cl;
+    PosType w, h;
+    unsigned size;
+};
+}  // end namespace JPS
+// ============================
+// ====== 死胡同剪枝 ======
+// ============================
+// 只能经过一个“门”进出的区域（只有一个门的房间、走不通的走廊以及它们后面的一切）：
+// 如果起点和目标都不在区域内，最短路径不需要进入它，因为从门的一个格子进去再从门的另一个格子出来
+// 不会比直接沿着门走更短。门是一行（或一列）中两端被阻挡的连续可行走格子，
+// 沿着它走的代价就是两个格子之间的距离，所以任何宽度的门都可以。
+// DeadEndMap预先找出这些区域：把每一行的连续格子当作一个顶点，两行中重叠的段相连，
+// 用Tarjan算法找出割点；每一列同样再做一次。每个格子存储它在两种分解中所在的最内层区域的编号。
+// DeadEndGrid在每次查询时把不包含起点或目标的区域视为不可行走，搜索就不会扫描它们。
+//   JPS::DeadEndMap dmap;
+//   dmap.build(grid, width, height);  // 地图改变时重新计算
+//   JPS::DeadEndGrid<MyGrid> dgrid(grid, dmap);
+//   JPS::Searcher<JPS::DeadEndGrid<MyGrid> > search(dgrid);
+//   dgrid.setQuery(start, end);  // 每次搜索之前
+//   search.findPath(path, start, end, step);
+// 被隐藏的格子与区域外的格子只在门处相邻，所以隐藏它们不会阻挡区域外的对角线移动；
+// 最短路径的代价不变（JPS_Flag_FourConnected同样适用）。
+// 剪枝减少展开的节点，但每次网格查询要多查两次表：在走廊、迷宫类的地图上快得多，
+// 在开阔的地图上可能反而更慢，请在自己的地图上测量。
+namespace JPS {
+class DeadEndMap {
+public:
+    enum Axis {
+        ROWS,  // 门是水平的
+        COLUMNS
+    };
+    DeadEndMap(void* user = 0) : w(0), h(0) {
+        for (unsigned a = 0; a < 2; ++a) {
+            region[a]._user = user;
+            last[a]._user = user;
+        }
+    }
+    // 从任何2D GRID仿函数计算。内存不足时返回false。
+    template <typename GRID>
+    bool build(const GRID& grid, PosType width, PosType height);
+    // 格子所在的最内层死胡同区域，0表示不在任何死胡同中（越界时也是0）。
+    // 区域按深度优先的顺序编号，所以区域r包含的区域（包括r本身）正好是r..getLast(a, r)。
+    inline unsigned operator()(Axis a, PosType x, PosType y) const {
+        return x < w && y < h ? region[a][SizeT(y) * w + x] : 0;
+    }
+    inline unsigned getLast(Axis a, unsigned r) const {
+        return last[a][r];
+    }
+    // 最内层区域是inner的格子是否在区域r内
+    inline bool contains(Axis a, unsigned r, unsigned inner) const {
+        return r <= inner && inner <= last[a][r];
+    }
+    inline unsigned getNumRegions(Axis a) const {
+        return last[a].size() ? last[a].size() - 1 : 0;
+    }
+    inline PosType width() const {
+        return w;
+    }
+    inline PosType height() const {
+        return h;
+    }
+    SizeT _getMemSize() const {
+        return region[0]._getMemSize() + region[1]._getMemSize() + last[0]._getMemSize() + last[1]._getMemSize();
+    }
+private:
+    // 交换x和y，这样按列的分解可以用按行的代码
+    template <typename GRID>
+    struct Transposed {
+        Transposed(const GRID& g) : g(g) {
+        }
+        inline bool operator()(PosType x, PosType y) const {
+            return !!g(y, x);
+        }
+        const GRID& g;
+    };
+    struct Run {
+        PosType y, x0, x1;
+    };
+    template <typename GRID>
+    bool _build(const GRID& grid, PosType width, PosType height, Axis a);
+    PosType w, h;
+    Internal::PodVec<unsigned> region[2];  // 每个格子一个
+    Internal::PodVec<unsigned> last[2];    // 每个区域一个，last[0]不使用
+};
+template <typename GRID>
+bool DeadEndMap::build(const GRID& grid, PosType width, PosType height) {
+    w = width;
+    h = height;
+    if (!_build(grid, width, height, ROWS) || !_build(Transposed<GRID>(grid), height, width, COLUMNS)) {
+        for (unsigned a = 0; a < 2; ++a) {
+            region[a].dealloc();
+            last[a].dealloc();
+        }
+        w = h = 0;
+        return false;
+    }
+    return true;
+}
+// 在(width, height)的网格上按行分解；a == COLUMNS时网格是转置的，结果转置回去保存
+template <typename GRID>
+bool DeadEndMap::_build(const GRID& grid, PosType width, PosType height, Axis a) {
+    const unsigned none = unsigned(-1);
+    const SizeT n = SizeT(width) * height;
+    void* const user = region[a]._user;
+    // 每行的连续格子
+    Internal::PodVec<unsigned> runOf(user);
+    Internal::PodVec<Run> runs(user);
+    runOf.resize(n);
+    if (runOf.size() != n)
+        return false;
+    for (PosType y = 0; y < height; ++y)
+        for (PosType x = 0; x < width; ++x) {
+            unsigned& r = runOf[SizeT(y) * width + x];
+            r = none;
+            if (!grid(x, y))
+                continue;
+            if (x && runOf[SizeT(y) * width + x - 1] != none) {
+                r = runOf[SizeT(y) * width + x - 1];
+                runs[r].x1 = x;
+                continue;
+            }
+            r = runs.size();
+            Run run = {y, x, x};
+            runs.push_back(run);
+            if (runs.size() != r + 1)
+                return false;
+        }
+    // 段的图上的深度优先搜索。disc是访问序号，order是它的逆；
+    // 搜索结束后low[u]变成u的子树结束之后的序号。cur[u]是下一个要看的邻居位置（先上一行，再下一行），
+    // 最高位标记u的子树只通过父节点与其他段相连（low >= disc[父节点]），即一个死胡同区域。
+    const SizeT m = runs.size();
+    const unsigned FLAG = 0x80000000u;
+    Internal::PodVec<unsigned> disc(user), low(user), order(user), cur(user), stack(user);
+    disc.resize(m);
+    low.resize(m);
+    order.resize(m);
+    cur.resize(m);
+    stack.resize(m);
+    last[a].clear();
+    last[a].resize(1);
+    region[a].resize(n);
+    if (disc.size() != m || low.size() != m || order.size() != m || cur.size() != m || stack.size() != m ||
+        last[a].size() != 1 || region[a].size() != n)
+        return false;
+    for (SizeT i = 0; i < m; ++i)
+        disc[i] = none;
+    SizeT t = 0;
+    for (SizeT i = 0; i < m; ++i) {
+        if (disc[i] != none)
+            continue;
+        // 根所在的一侧永远不会被剪枝，所以根应该在分量的主要部分中：
+        // 如果最外层的一个区域大于分量的一半，就从它里面重新开始（最多几次）
+        SizeT root = i;
+        for (unsigned attempt = 0;; ++attempt) {
+            SizeT t1 = t;
+            disc[root] = low[root] = unsigned(t1);
+            order[t1++] = unsigned(root);
+            cur[root] = 0;
+            SizeT top = 0;
+            stack[top++] = unsigned(root);
+            while (top) {
+                const SizeT u = stack[top - 1];
+                const Run& ru = runs[u];
+                const unsigned len = ru.x1 - ru.x0 + 1;
+                SizeT v = none;
+                while ((cur[u] & ~FLAG) < 2 * len && v == none) {
+                    const unsigned k = cur[u]++ & ~FLAG;
+                    const PosType x = ru.x0 + k % len;
+                    const PosType y = k < len ? ru.y - 1 : ru.y + 1;
+                    if (y >= height)
+                        continue;  // 包括0 - 1
+                    const unsigned c = runOf[SizeT(y) * width + x];
+                    if (c != none && (x == ru.x0 || runOf[SizeT(y) * width + x - 1] != c))
+                        v = c;
+                }
+                if (v != none) {
+                    if (disc[v] == none) {
+                        disc[v] = low[v] = unsigned(t1);
+                        order[t1++] = unsigned(v);
+                        cur[v] = 0;
+                        stack[top++] = unsigned(v);
+                    } else
+                        low[u] = Min(low[u], disc[v]);
+                    continue;
+                }
+                --top;
+                const unsigned lowu = low[u];
+                low[u] = unsigned(t1);  // 子树结束
+                if (top) {
+                    const SizeT p = stack[top - 1];
+                    low[p] = Min(low[p], lowu);
+                    if (lowu >= disc[p])
+                        cur[u] |= FLAG;
+                }
+            }
+            if (t + 1 < t1 && low[order[t + 1]] == t1)
+                cur[order[t + 1]] &= ~FLAG;  // 根只有一个子节点：它的子树是根以外的一切，不是死胡同
+            SizeT best = none;
+            for (SizeT k = t + 1; k < t1;) {
+                const SizeT u = order[k];
+                if (cur[u] & FLAG) {
+                    if (best == none || low[u] - disc[u] > low[best] - disc[best])
+                        best = u;
+                    k = low[u];
+                } else
+                    ++k;
+            }
+            if (attempt == 3 || best == none || 2 * (low[best] - disc[best]) <= t1 - t) {
+                t = t1;
+                break;
+            }
+            for (SizeT k = t; k < t1; ++k)
+                disc[order[k]] = none;
+            root = best;
+        }
+    }
+    SizeT num = 0;
+    for (SizeT u = 0; u < m; ++u)
+        num += cur[u] >> 31;
+    last[a].resize(num + 1);
+    if (last[a].size() != num + 1)
+        return false;
+    last[a][0] = 0;
+    // 按访问顺序给区域编号；区域是它的根段的子树，访问序号是连续的。每个段的区域暂时存在disc中。
+    SizeT top = 0, id = 0;  // stack：打开的区域的根段
+    for (SizeT k = 0; k < m; ++k) {
+        while (top && low[stack[top - 1]] <= k) {
+            --top;
+            last[a][disc[stack[top]]] = unsigned(id);
+        }
+        const SizeT u = order[k];
+        if (cur[u] & FLAG) {
+            disc[u] = unsigned(++id);
+            stack[top++] = unsigned(u);
+        } else
+            disc[u] = top ? disc[stack[top - 1]] : 0;
+    }
+    while (top) {
+        --top;
+        last[a][disc[stack[top]]] = unsigned(id);
+    }
+    for (PosType y = 0; y < height; ++y)
+        for (PosType x = 0; x < width; ++x) {
+            const unsigned r = runOf[SizeT(y) * width + x];
+            region[a][a == COLUMNS ? SizeT(x) * height + y : SizeT(y) * width + x] = r == none ? 0 : disc[r];
+        }
+    return true;
+}
+// 隐藏不包含起点或目标的死胡同区域的GRID仿函数。不拥有网格和DeadEndMap。
+template <typename GRID>
+class DeadEndGrid {
+public:
+    DeadEndGrid(const GRID& g, const DeadEndMap& m) : grid(g), map(m) {
+        rs[0] = rs[1] = rt[0] = rt[1] = 0;
+    }
+    // 在每次搜索之前调用（不要在增量寻路的过程中改变）
+    void setQuery(const Position& start, const Position& goal) {
+        for (unsigned a = 0; a < 2; ++a) {
+            rs[a] = map(DeadEndMap::Axis(a), start.x, start.y);
+            rt[a] = map(DeadEndMap::Axis(a), goal.x, goal.y);
+        }
+    }
+    inline bool operator()(PosType x, PosType y) const {
+        return grid(x, y) && _visible(DeadEndMap::ROWS, x, y) && _visible(DeadEndMap::COLUMNS, x, y);
+    }
+private:
+    inline bool _visible(DeadEndMap::Axis a, PosType x, PosType y) const {
+        const unsigned r = map(a, x, y);
+        return !r || map.contains(a, r, rs[a]) || map.contains(a, r, rt[a]);
+    }
+    const GRID& grid;
+    const DeadEndMap& map;
+    unsigned rs[2], rt[2];
+};
+}  // end namespace JPS
+// ============================
+// ====== 加权网格 ======
+// ============================
+// WeightedSearcher：每个格子有自己的代价的网格上的寻路。
+// COSTGRID仿函数需要重载operator()(x, y) const，返回格子的代价（0..255），0表示不可行走。
+// 您仍然负责边界检查（越界时返回0）。
+// 在两个相邻格子a, b之间移动的代价为：直线 5 * (cost(a) + cost(b))，对角线 7 * (cost(a) + cost(b))，
+// 即代价为1的格子之间直线移动代价10，对角线移动代价14。对角线移动规则与2D Searcher相同。
+// 搜索是使用桶队列的A*。在代价一致的区域内（一个格子和它的8个邻居的代价相同或不可行走）
+// 使用JPS的跳跃和剪枝；跳跃在离开这样的区域时停止，非一致的格子作为普通A*节点展开全部8个邻居。
+// 所以大片的道路、草地等仍然可以快速跳过，而地形交界处退化为A*。
+// 启发式是八方向距离乘以minCost，minCost必须是地图上最小的非0代价（或更小），否则路径可能不是最优的。
+//   JPS::WeightedSearcher<MyCostGrid> search(grid, minCost);
+//   if (search.findPath(path, JPS::Pos(x0, y0), JPS::Pos(x1, y1), step))
+//       unsigned cost = search.getPathCost();
+// 支持的标志：JPS_Flag_AStarOnly, JPS_Flag_NoStartCheck, JPS_Flag_NoEndCheck。
+// 没有贪婪的直线检查（直线不一定是最便宜的），所以JPS_Flag_NoGreedy没有作用；JPS_Flag_FourConnected不支持。
+// 增量接口findPathInit()/findPathStep()/findPathFinish()与Searcher相同。
+namespace JPS {
+namespace Internal {
+typedef NodeT<Position, unsigned> WNode;
+template <typename COSTGRID>
+class WeightedSearcher {
+public:
+    WeightedSearcher(const COSTGRID& g, unsigned minCost = 1, void* user = 0)
+        : grid(g),
+          storage(user),
+          nodemap(storage),
+          open(user),
+          endPos(npos),
+          endNodeIdx(noidx),
+          flags(0),
+          stepsRemain(0),
+          stepsDone(0),
+          minCost(minCost) {
+    }
+#if JPS_HAS_MOVE
+    WeightedSearcher(WeightedSearcher&& o)
+        : grid(o.grid),
+          storage(o.storage._user),
+          nodemap(storage),
+          open(o.storage._user),
+          endPos(npos),
+          endNodeIdx(noidx),
+          flags(0),
+          stepsRemain(0),
+          stepsDone(0),
+          minCost(o.minCost) {
+        swap(o);
+    }
+    WeightedSearcher& operator=(WeightedSearcher&& o) {
+        swap(o);
+        return *this;
+    }
+#endif
+    // 改用另一个网格，保留已分配的内存。中止正在进行的搜索；minCost不变，需要时调用setMinCost()。
+    void rebind(const COSTGRID& g) {
+        grid = GridRef<COSTGRID, unsigned>(g);
+        clear();
+    }
+    inline const COSTGRID& getGrid() const {
+        return grid.get();
+    }
+    void swap(WeightedSearcher& o) {
+        Swap(grid, o.grid);
+        storage._swap(o.storage);
+        nodemap._swap(o.nodemap);
+        open._swap(o.open);
+        Swap(endPos, o.endPos);
+        Swap(endNodeIdx, o.endNodeIdx);
+        Swap(flags, o.flags);
+        Swap(stepsRemain, o.stepsRemain);
+        Swap(stepsDone, o.stepsDone);
+        Swap(minCost, o.minCost);
+        Swap(mem, o.mem);
+    }
+    // 单次调用
+    template <typename PV>
+    bool findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags = JPS_Flag_Default);
+    // 增量路径查找
+    JPS_Result findPathInit(Position start, Position end, JPS_Flags flags = JPS_Flag_Default);
+    JPS_Result findPathStep(int limit);
+    template <typename PV>
+    JPS_Result findPathFinish(PV& path, unsigned step) const {
+        return GeneratePath(storage, endNodeIdx, path, step);
+    }
+    // 与Searcher相同
+    inline SizeT getPathLength(unsigned step) const {
+        return PathLength(storage, endNodeIdx, step);
+    }
+    SizeT writePath(Position* out, SizeT cap, unsigned step) const {
+        const SizeT len = getPathLength(step);
+        if (len && len <= cap)
+            WritePathBackwards(storage, endNodeIdx, out + len, step);
+        return len;
+    }
+    // 找到的路径的代价（在findPathStep()返回JPS_FOUND_PATH之后有效）
+    unsigned getPathCost() const {
+        return endNodeIdx != noidx ? storage[endNodeIdx].g : 0;
+    }
+    // 地图上最小的非0代价，用于启发式
+    void setMinCost(unsigned c) {
+        minCost = c;
+    }
+    void freeMemory() {
+        open.dealloc();
+        nodemap.dealloc();
+        storage.dealloc();
+        endNodeIdx = noidx;
+        mem.watermark = 0;
+    }
+    // 与Searcher相同，见MemBudget
+    inline void setMemoryLimit(SizeT bytes) {
+        mem.limit = bytes;
+    }
+    inline SizeT getMemoryLimit() const {
+        return mem.limit;
+    }
+    inline void setAutoShrink(bool on) {
+        mem.autoShrink = on;
+    }
+    // --- Statistics ---
+    inline SizeT getStepsDone() const {
+        return stepsDone;
+    }
+    inline SizeT getNodesExpanded() const {
+        return storage.size();
+    }
+    SizeT getTotalMemoryInUse() const {
+        return storage._getMemSize() + nodemap._getMemSize() + open._getMemSize();
+    }
+private:
+    GridRef<COSTGRID, unsigned> grid;
+    PodVec<WNode> storage;
+    NodeMapT<WNode> nodemap;
+    BucketQueue open;
+    Position endPos;
+    SizeT endNodeIdx;
+    JPS_Flags flags;
+    int stepsRemain;
+    SizeT stepsDone;
+    unsigned minCost;
+    MemBudget mem;
+    void clear() {
+        const SizeT used = storage.size();
+        open.clear();
+        nodemap.clear();
+        storage.clear();
+        endNodeIdx = noidx;
+        stepsDone = 0;
+        if (const SizeT keep = mem.decay(used, storage.capacity())) {
+            open._shrink(keep);
+            nodemap._shrink(keep);
+            storage._shrink(keep);
+        }
+    }
+    // 同SearcherBaseT::_getNode()。桶队列的大小不容易预测，只计算它当前的大小
+    inline WNode* _getNode(const Position& pos) {
+        if (mem.limit) {
+            if (const WNode* n = nodemap.find(pos))
+                return const_cast<WNode*>(n);
+            if (!mem.allow(storage._nextMemSize() + nodemap._nextMemSize() + open._getMemSize()))
+                return 0;
+        }
+        return nodemap(pos);
+    }
+    inline unsigned heuristic(const Position& p) const {
+        const unsigned dx = Abs(int(p.x - endPos.x));
+        const unsigned dy = Abs(int(p.y - endPos.y));
+        return minCost * (10 * Max(dx, dy) + 4 * Min(dx, dy));
+    }
+    bool isUniform(PosType x, PosType y, unsigned c) const;
+    bool identifySuccessors(const WNode& n);
+    unsigned findNeighborsAStar(const WNode& n, Position* wptr);
+    unsigned findNeighborsJPS(const WNode& n, Position* wptr) const;
+    Position jumpP(const Position& p, const Position& src);
+    Position jumpD(Position p, int dx, int dy);
+    Position jumpX(Position p, int dx);
+    Position jumpY(Position p, int dy);
+    // 禁止任何操作
+    WeightedSearcher& operator=(const WeightedSearcher<COSTGRID>&);
+    WeightedSearcher(const WeightedSearcher<COSTGRID>&);
+};
+// (x, y)的8个邻居是否都不可行走或者代价为c
+template <typename COSTGRID>
+bool WeightedSearcher<COSTGRID>::isUniform(PosType x, PosType y, unsigned c) const {
+    for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+            if (dx || dy) {
+                const unsigned v = grid(x + dx, y + dy);
+                if (v && v != c)
+                    return false;
+            }
+    return true;
+}
+template <typename COSTGRID>
+Position WeightedSearcher<COSTGRID>::jumpP(const Position& p, const Position& src) {
+    JPS_ASSERT(grid(p.x, p.y));
+    const int dx = int(p.x - src.x);
+    const int dy = int(p.y - src.y);
+    JPS_ASSERT(dx || dy);
+    if (dx && dy)
+        return jumpD(p, dx, dy);
+    return dx ? jumpX(p, dx) : jumpY(p, dy);
+}
+// 与Searcher::jumpD相同，另外在离开代价一致的区域时停止
+template <typename COSTGRID>
+Position WeightedSearcher<COSTGRID>::jumpD(Position p, int dx, int dy) {
+    JPS_ASSERT(dx && dy);
+    const Position endpos = endPos;
+    const unsigned c = grid(p.x, p.y);
+    unsigned steps = 0;
+    while (true) {
+        if (p == endpos)
+            break;
+        ++steps;
+        const PosType x = p.x;
+        const PosType y = p.y;
+        if (!isUniform(x, y, c))
+            break;
+        if ((grid(x - dx, y + dy) && !grid(x - dx, y)) || (grid(x + dx, y - dy) && !grid(x, y - dy)))
+            break;
+        const bool gdx = !!grid(x + dx, y);
+        const bool gdy = !!grid(x, y + dy);
+        if (gdx && jumpX(Pos(x + dx, y), dx).isValid())
+            break;
+        if (gdy && jumpY(Pos(x, y + dy), dy).isValid())
+            break;
+        if ((gdx || gdy) && grid(x + dx, y + dy)) {
+            p.x += dx;
+            p.y += dy;
+        } else {
+            p = npos;
+            break;
+        }
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+// 与Searcher::jumpX相同，另外在离开代价一致的区域时停止。
+// 上一个格子的邻域已知是一致的，所以每一步只需要检查前方新的一列。
+template <typename COSTGRID>
+Position WeightedSearcher<COSTGRID>::jumpX(Position p, int dx) {
+    JPS_ASSERT(dx);
+    const PosType y = p.y;
+    const unsigned c = grid(p.x, y);
+    if (!isUniform(p.x, y, c))
+        return p;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+    unsigned a = ~((!!grid(p.x, y + 1)) | ((!!grid(p.x, y - 1)) << 1));
+    while (true) {
+        const unsigned xx = p.x + dx;
+        const unsigned b = (!!grid(xx, y + 1)) | ((!!grid(xx, y - 1)) << 1);
+        if ((b & a) || p == endpos)
+            break;
+        if (!grid(xx, y)) {
+            p = npos;
+            break;
+        }
+        p.x += dx;
+        a = ~b;
+        ++steps;
+        const PosType nx = p.x + dx;
+        const unsigned c0 = grid(nx, y - 1), c1 = grid(nx, y), c2 = grid(nx, y + 1);
+        if ((c0 && c0 != c) || (c1 && c1 != c) || (c2 && c2 != c))
+            break;
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+template <typename COSTGRID>
+Position WeightedSearcher<COSTGRID>::jumpY(Position p, int dy) {
+    JPS_ASSERT(dy);
+    const PosType x = p.x;
+    const unsigned c = grid(x, p.y);
+    if (!isUniform(x, p.y, c))
+        return p;
+    const Position endpos = endPos;
+    unsigned steps = 0;
+    unsigned a = ~((!!grid(x + 1, p.y)) | ((!!grid(x - 1, p.y)) << 1));
+    while (true) {
+        const unsigned yy = p.y + dy;
+        const unsigned b = (!!grid(x + 1, yy)) | ((!!grid(x - 1, yy)) << 1);
+        if ((a & b) || p == endpos)
+            break;
+        if (!grid(x, yy)) {
+            p = npos;
+            break;
+        }
+        p.y += dy;
+        a = ~b;
+        ++steps;
+        const PosType ny = p.y + dy;
+        const unsigned c0 = grid(x - 1, ny), c1 = grid(x, ny), c2 = grid(x + 1, ny);
+        if ((c0 && c0 != c) || (c1 && c1 != c) || (c2 && c2 != c))
+            break;
+    }
+    stepsDone += steps;
+    stepsRemain -= steps;
+    return p;
+}
+#define JPS_CHECKGRID(dx, dy) (grid(x + (dx), y + (dy)))
+#define JPS_ADDPOS(dx, dy)              \
+    do {                                \
+        *w++ = Pos(x + (dx), y + (dy)); \
+    } while (0)
+#define JPS_ADDPOS_CHECK(dx, dy)   \
+    do {                           \
+        if (JPS_CHECKGRID(dx, dy)) \
+            JPS_ADDPOS(dx, dy);    \
+    } while (0)
+#define JPS_ADDPOS_NO_TUNNEL(dx, dy)                \
+    do {                                            \
+        if (grid(x + (dx), y) || grid(x, y + (dy))) \
+            JPS_ADDPOS_CHECK(dx, dy);               \
+    } while (0)
+// 代价一致的节点与Searcher::findNeighborsJPS相同；其他节点展开全部邻居
+template <typename COSTGRID>
+unsigned WeightedSearcher<COSTGRID>::findNeighborsJPS(const WNode& n, Position* wptr) const {
+    Position* w = wptr;
+    const unsigned x = n.pos.x;
+    const unsigned y = n.pos.y;
+    if (!n.hasParent() || !isUniform(x, y, grid(x, y))) {
+        JPS_ADDPOS_CHECK(-1, 0);
+        JPS_ADDPOS_CHECK(0, -1);
+        JPS_ADDPOS_CHECK(0, 1);
+        JPS_ADDPOS_CHECK(1, 0);
+        JPS_ADDPOS_NO_TUNNEL(-1, -1);
+        JPS_ADDPOS_NO_TUNNEL(-1, 1);
+        JPS_ADDPOS_NO_TUNNEL(1, -1);
+        JPS_ADDPOS_NO_TUNNEL(1, 1);
+        return unsigned(w - wptr);
+    }
+    const WNode& p = n.getParent();
+    const int dx = Sgn<int>(x - p.pos.x);
+    const int dy = Sgn<int>(y - p.pos.y);
+    if (dx && dy) {
+        // 自然邻居
+        const bool walkX = !!grid(x + dx, y);
+        if (walkX)
+            *w++ = Pos(x + dx, y);
+        const bool walkY = !!grid(x, y + dy);
+        if (walkY)
+            *w++ = Pos(x, y + dy);
+        if (walkX || walkY)
+            JPS_ADDPOS_CHECK(dx, dy);
+        // 强制邻居
+        if (walkY && !JPS_CHECKGRID(-dx, 0))
+            JPS_ADDPOS_CHECK(-dx, dy);
+        if (walkX && !JPS_CHECKGRID(0, -dy))
+            JPS_ADDPOS_CHECK(dx, -dy);
+    } else if (dx) {
+        if (JPS_CHECKGRID(dx, 0)) {
+            JPS_ADDPOS(dx, 0);
+            // 强制邻居（+防止穿墙）
+            if (!JPS_CHECKGRID(0, 1))
+                JPS_ADDPOS_CHECK(dx, 1);
+            if (!JPS_CHECKGRID(0, -1))
+                JPS_ADDPOS_CHECK(dx, -1);
+        }
+    } else if (dy) {
+        if (JPS_CHECKGRID(0, dy)) {
+            JPS_ADDPOS(0, dy);
+            // 强制邻居（+防止穿墙）
+            if (!JPS_CHECKGRID(1, 0))
+                JPS_ADDPOS_CHECK(1, dy);
+            if (!JPS_CHECKGRID(-1, 0))
+                JPS_ADDPOS_CHECK(-1, dy);
+        }
+    }
+    return unsigned(w - wptr);
+}
+template <typename COSTGRID>
+unsigned WeightedSearcher<COSTGRID>::findNeighborsAStar(const WNode& n, Position* wptr) {
+    Position* w = wptr;
+    const int x = n.pos.x;
+    const int y = n.pos.y;
+    JPS_ADDPOS_NO_TUNNEL(-1, -1);
+    JPS_ADDPOS_CHECK(0, -1);
+    JPS_ADDPOS_NO_TUNNEL(+1, -1);
+    JPS_ADDPOS_CHECK(-1, 0);
+    JPS_ADDPOS_CHECK(+1, 0);
+    JPS_ADDPOS_NO_TUNNEL(-1, +1);
+    JPS_ADDPOS_CHECK(0, +1);
+    JPS_ADDPOS_NO_TUNNEL(+1, +1);
+    stepsDone += 8;
+    return unsigned(w - wptr);
+}
+#undef JPS_ADDPOS
+#undef JPS_ADDPOS_CHECK
+#undef JPS_ADDPOS_NO_TUNNEL
+#undef JPS_CHECKGRID
+template <typename COSTGRID>
+bool WeightedSearcher<COSTGRID>::identifySuccessors(const WNode& n_) {
+    const SizeT nidx = storage.getindex(&n_);
+    const Position np = n_.pos;
+    const unsigned cn = grid(np.x, np.y);
+    Position buf[8];
+    const int num = (flags & JPS_Flag_AStarOnly) ? findNeighborsAStar(n_, &buf[0]) : findNeighborsJPS(n_, &buf[0]);
+    for (int i = num - 1; i >= 0; --i) {
+        Position jp;
+        if (flags & JPS_Flag_AStarOnly)
+            jp = buf[i];
+        else {
+            jp = jumpP(buf[i], np);
+            if (!jp.isValid())
+                continue;
+        }
+        WNode* jn = _getNode(jp);  // 这可能会重新分配存储
+        if (!jn)
+            return false;  // 内存不足
+        if (jn->isClosed())
+            continue;
+        const WNode& n = storage[nidx];  // 在重新分配的情况下获取有效的引用
+        JPS_ASSERT(jn != &n);
+        // 跳跃经过的格子（除了起点）的代价都与jp相同
+        const unsigned c = grid(jp.x, jp.y);
+        const unsigned len = Max(Abs(int(jp.x - np.x)), Abs(int(jp.y - np.y)));
+        const unsigned unit = (jp.x != np.x && jp.y != np.y) ? 7 : 5;
+        const unsigned newG = n.g + unit * (cn + c) + (len - 1) * unit * 2 * c;
+        if (!jn->isOpen() || newG < jn->g) {
+            jn->g = newG;
+            jn->f = newG + heuristic(jp);
+            jn->setParent(n);
+            if (!open.push(jn->f, storage.getindex(jn)))
+                return false;
+            jn->setOpen();
+        }
+    }
+    return true;
+}
+template <typename COSTGRID>
+template <typename PV>
+bool WeightedSearcher<COSTGRID>::findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags) {
+    JPS_Result res = findPathInit(start, end, flags);
+    if (res == JPS_EMPTY_PATH)
+        return true;
+    while (res == JPS_NEED_MORE_STEPS)
+        res = findPathStep(0);
+    return res == JPS_FOUND_PATH && findPathFinish(path, step) == JPS_FOUND_PATH;
+}
+template <typename COSTGRID>
+JPS_Result WeightedSearcher<COSTGRID>::findPathInit(Position start, Position end, JPS_Flags flags) {
+    this->clear();
+    this->flags = flags;
+    endPos = end;
+    if (start == end && !(flags & (JPS_Flag_NoStartCheck | JPS_Flag_NoEndCheck)))
+        return grid(end.x, end.y) ? JPS_EMPTY_PATH : JPS_NO_PATH;
+    if (!(flags & JPS_Flag_NoStartCheck))
+        if (!grid(start.x, start.y))
+            return JPS_NO_PATH;
+    if (!(flags & JPS_Flag_NoEndCheck))
+        if (!grid(end.x, end.y))
+            return JPS_NO_PATH;
+    WNode* endNode = _getNode(end);
+    if (!endNode)
+        return mem.failResult();
+    endNodeIdx = storage.getindex(endNode);
+    WNode* startNode = _getNode(start);
+    if (!startNode)
+        return mem.failResult();
+    startNode->f = heuristic(start);
+    if (!open.push(startNode->f, storage.getindex(startNode)))
+        return JPS_OUT_OF_MEMORY;
+    startNode->setOpen();
+    return JPS_NEED_MORE_STEPS;
+}
+template <typename COSTGRID>
+JPS_Result WeightedSearcher<COSTGRID>::findPathStep(int limit) {
+    stepsRemain = limit;
+    do {
+        WNode* n;
+        do {
+            if (open.empty())
+                return JPS_NO_PATH;
+            BucketQueue::Entry e;
+            if (!open.pop(e))
+                return JPS_OUT_OF_MEMORY;
+            n = &storage[e.idx];
+        } while (n->isClosed());  // 跳过被更短路径取代的条目
+        n->setClosed();
+        if (n->pos == endPos)
+            return JPS_FOUND_PATH;
+        if (!identifySuccessors(*n))
+            return mem.failResult();
+    } while (stepsRemain >= 0);
+    return JPS_NEED_MORE_STEPS;
+}
+}  // end namespace Internal
+using Internal::WeightedSearcher;
+}  // end namespace JPS
+// ============================
+// ====== JPS3D (体素网格) ======
+// ============================
+// 与2D版本相同的思路，扩展到3D体素网格，每个格子有26个邻居。
+// GRID仿函数需要重载operator()(x, y, z) const，并负责边界检查。
+// 移动规则：对角移动（2轴或3轴）要求其跨越的所有格子都可行走（不允许切角），
+// 即从(x, y, z)移动(dx, dy, dz)时，所有(x + a*dx, y + b*dy, z + c*dz)，a/b/c ∈ {0, 1}都必须可行走。
+// 用法与2D版本相同：
+//   JPS3D::Searcher<MyVoxelGrid> search(grid);
+//   JPS3D::PathVector path;
+//   search.findPath(path, JPS3D::Pos(x0, y0, z0), JPS3D::Pos(x1, y1, z1), step);
+// 支持相同的标志（JPS_Flag_NoGreedy, JPS_Flag_AStarOnly, JPS_Flag_NoStartCheck, JPS_Flag_NoEndCheck）
+// 以及增量接口findPathInit()/findPathStep()/findPathFinish()。
+namespace JPS {
+namespace Internal {
+class SearcherBase3D : public SearcherBaseT<Node3> {
+protected:
+    SearcherBase3D(void* user) : SearcherBaseT<Node3>(user, npos3) {
+    }
+public:
+    template <typename PV>
+    JPS_Result generatePath(PV& path, unsigned step) const;
+};
+template <typename PV>
+JPS_Result SearcherBase3D::generatePath(PV& path, unsigned step) const {
+    return GeneratePath(storage, endNodeIdx, path, step);
+}
+}  // end namespace Internal
+}  // end namespace JPS
+
+namespace JPS3D {
+using JPS::PosType;
+using JPS::SizeT;
+using JPS::ScoreType;
+typedef JPS::Position3 Position;
+typedef JPS::Internal::PodVec<Position> PathVector;
+typedef JPS::StepIteratorT<Position> StepIterator;
+static const Position npos = JPS::npos3;
+inline static Position Pos(PosType x, PosType y, PosType z) {
+    return JPS::Pos3(x, y, z);
+}
+
+// 按位压缩的体素网格，每个格子1位（1 = 可行走）。可以直接作为Searcher的GRID使用。
+// 内存通过JPS_realloc/JPS_free分配。
+class VoxelGrid {
+public:
+    VoxelGrid(void* user = 0) : w(0), h(0), d(0), rowWords(0), bits(user) {
+    }
+    // 分配并清空（全部不可行走）。内存不足时返回false。
+    bool init(PosType width, PosType height, PosType depth) {
+        const SizeT rw = (width + 31) / 32;
+        bits.clear();
+        bits.resize(rw * height * depth);
+        if (bits.size() != rw * height * depth) {
+            w = h = d = rowWords = 0;
+            return false;
+        }
+        w = width;
+        h = height;
+        d = depth;
+        rowWords = rw;
+        for (SizeT i = 0; i < bits.size(); ++i)
+            bits[i] = 0;
+        return true;
+    }
+    inline void set(PosType x, PosType y, PosType z, bool walkable) {
+        JPS_ASSERT(x < w && y < h && z < d);
+        unsigned& word = bits[_index(x, y, z)];
+        const unsigned m = 1u << (x & 31);
+        word = walkable ? (word | m) : (word & ~m);
+    }
+    inline unsigned operator()(PosType x, PosType y, PosType z) const {
+        return x < w && y < h && z < d && ((bits[_index(x, y, z)] >> (x & 31)) & 1);
+    }
+    inline PosType width() const {
+        return w;
+    }
+    inline PosType height() const {
+        return h;
+    }
+    inline PosType depth() const {
+        return d;
+    }
+    SizeT _getMemSize() const {
+        return bits._getMemSize();
+    }
+private:
+    inline SizeT _index(PosType x, PosType y, PosType z) const {
+        return (SizeT(z) * h + y) * rowWords + (x >> 5);
+    }
+    PosType w, h, d;
+    SizeT rowWords;
+    JPS::Internal::PodVec<unsigned> bits;
+};
+
+template <typename GRID>
+class Searcher : public JPS::Internal::SearcherBase3D {
+public:
+    Searcher(const GRID& g, void* user = 0) : SearcherBase3D(user), grid(g) {
+    }
+#if JPS_HAS_MOVE
+    Searcher(Searcher&& o) : SearcherBase3D(o.storage._user), grid(o.grid) {
+        swap(o);
+    }
+    Searcher& operator=(Searcher&& o) {
+        swap(o);
+        return *this;
+    }
+#endif
+    // 与2D Searcher相同
+    void rebind(const GRID& g) {
+        grid = JPS::Internal::GridRef<GRID>(g);
+        clear();
+        _mtReset();
+    }
+    inline const GRID& getGrid() const {
+        return grid.get();
+    }
+    void swap(Searcher& o) {
+        _swapState(o);
+        JPS::Internal::Swap(grid, o.grid);
+    }
+    // 单次调用
+    template <typename PV>
+    bool findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags = JPS_Flag_Default);
+    // 增量路径查找
+    JPS_Result findPathInit(Position start, Position end, JPS_Flags flags = JPS_Flag_Default);
+    JPS_Result findPathStep(int limit);
+    // 生成路径，在找到路径后
+    template <typename PV>
+    JPS_Result findPathFinish(PV& path, unsigned step) const;
+private:
+    typedef JPS::Internal::Node3 Node;
+    JPS::Internal::GridRef<GRID> grid;
+    Node* getNode(const Position& pos);
+    bool canMove(PosType x, PosType y, PosType z, int dx, int dy, int dz) const;
+    inline bool canMove(const Position& p, int dx, int dy, int dz) const {
+        return canMove(p.x, p.y, p.z, dx, dy, dz);
+    }
+    unsigned sideMask(PosType x, PosType y, PosType z, int dx, int dy, int dz) const;
+    unsigned forcedD2(PosType x, PosType y, PosType z, int dx, int dy, int dz) const;
+    bool identifySuccessors(const Node& n);
+    bool findPathGreedy(Node* start, Node* end);
+    // 沿直线/对角线直接走到endpos，最多拐两次
+    bool findDirectPath(Position p, const Position& endpos, Position* mid, unsigned& nmid) const;
+    unsigned findNeighborsAStar(const Node& n, Position* wptr);
+    unsigned findNeighborsJPS(const Node& n, Position* wptr) const;
+    Position jumpP(const Position& p, const Position& src);
+    Position jumpS(Position p, int dx, int dy, int dz);
+    Position jumpD2(Position p, int dx, int dy, int dz);
+    Position jumpD3(Position p, int dx, int dy, int dz);
+    // 禁止任何操作
+    Searcher& operator=(const Searcher<GRID>&);
+    Searcher(const Searcher<GRID>&);
+};
+// -----------------------------------------------------------------------
+template <typename GRID>
+inline typename Searcher<GRID>::Node* Searcher<GRID>::getNode(const Position& pos) {
+    JPS_ASSERT(grid(pos.x, pos.y, pos.z));
+    return this->_getNode(pos);
+}
+
+// 是否可以从(x, y, z)移动(dx, dy, dz)，不允许切角
+template <typename GRID>
+inline bool Searcher<GRID>::canMove(PosType x, PosType y, PosType z, int dx, int dy, int dz) const {
+    const int axes = !!dx + !!dy + !!dz;
+    if (axes >= 2) {
+        if ((dx && !grid(x + dx, y, z)) || (dy && !grid(x, y + dy, z)) || (dz && !grid(x, y, z + dz)))
+            return false;
+        if (axes == 3 && !(grid(x + dx, y + dy, z) && grid(x + dx, y, z + dz) && grid(x, y + dy, z + dz)))
+            return false;
+    }
+    return !!grid(x + dx, y + dy, z + dz);
+}
+
+// 沿直线方向(dx, dy, dz)移动时，垂直平面内8个侧向移动是否可行的位掩码。
+// 位0-3：4个面邻居；位4-7：4个棱邻居（需要两个面邻居和角都可行走）。
+template <typename GRID>
+unsigned Searcher<GRID>::sideMask(PosType x, PosType y, PosType z, int dx, int dy, int dz) const {
+    // 垂直于移动方向的两个轴u, v
+    const int ux = !!dz, uy = !!dx, uz = !!dy;  // dx->u=y, dy->u=z, dz->u=x
+    const int vx = !!dy, vy = !!dz, vz = !!dx;  // dx->v=z, dy->v=x, dz->v=y
+    const unsigned pu = !!grid(x + ux, y + uy, z + uz);
+    const unsigned nu = !!grid(x - ux, y - uy, z - uz);
+    const unsigned pv = !!grid(x + vx, y + vy, z + vz);
+    const unsigned nv = !!grid(x - vx, y - vy, z - vz);
+    unsigned m = pu | (nu << 1) | (pv << 2) | (nv << 3);
+    if (pu && pv && grid(x + ux + vx, y + uy + vy, z + uz + vz))
+        m |= 1 << 4;
+    if (pu && nv && grid(x + ux - vx, y + uy - vy, z + uz - vz))
+        m |= 1 << 5;
+    if (nu && pv && grid(x - ux + vx, y - uy + vy, z - uz + vz))
+        m |= 1 << 6;
+    if (nu && nv && grid(x - ux - vx, y - uy - vy, z - uz - vz))
+        m |= 1 << 7;
+    return m;
+}
+
+// 沿平面对角线(dx, dy, dz)到达(x, y, z)时，第三个轴上的强制邻居（位0：+轴，位1：-轴）。
+// 侧向格子n+s是强制的，除非它可以绕过n到达：上一个格子p的p+s可行走，且可以从p+s沿对角线移动到n+s。
+template <typename GRID>
+unsigned Searcher<GRID>::forcedD2(PosType x, PosType y, PosType z, int dx, int dy, int dz) const {
+    const int cx = !dx, cy = !dy, cz = !dz;  // 第三个轴
+    const PosType px = x - dx, py = y - dy, pz = z - dz;
+    unsigned m = 0;
+    if (grid(x + cx, y + cy, z + cz)
+        && !(grid(px + cx, py + cy, pz + cz) && canMove(px + cx, py + cy, pz + cz, dx, dy, dz)))
+        m |= 1;
+    if (grid(x - cx, y - cy, z - cz)
+        && !(grid(px - cx, py - cy, pz - cz) && canMove(px - cx, py - cy, pz - cz, dx, dy, dz)))
+        m |= 2;
+    return m;
+}
+
+template <typename GRID>
+Position Searcher<GRID>::jumpP(const Position& p, const Position& src) {
+    JPS_ASSERT(grid(p.x, p.y, p.z));
+    const int dx = JPS::Sgn(int(p.x - src.x));
+    const int dy = JPS::Sgn(int(p.y - src.y));
+    const int dz = JPS::Sgn(int(p.z - src.z));
+    switch (!!dx + !!dy + !!dz) {
+        case 1:
+            return jumpS(p, dx, dy, dz);
+        case 2:
+            return jumpD2(p, dx, dy, dz);
+        case 3:
+            return jumpD3(p, dx, dy, dz);
+    }
+    JPS_ASSERT(false);
+    return npos;
+}
+
+// 沿轴跳跃。当某个侧向移动在当前格子可行、而在上一个格子不可行时，当前格子是跳点。
+template <typename GRID>
+Position Searcher<GRID>::jumpS(Position p, int dx, int dy, int dz) {
+    JPS_ASSERT(grid(p.x, p.y, p.z));
+    const Position endpos = endPos;
+    unsigned steps = 0;
+    unsigned a = ~sideMask(p.x - dx, p.y - dy, p.z - dz, dx, dy, dz);
+    while (true) {
+        if (p == endpos)
+            break;
+        const unsigned b = sideMask(p.x, p.y, p.z, dx, dy, dz);
+        if (a & b)
             break;
-        if ((gdx || gdy) && grid(x + dx, y + dy)) {
-            p.x += dx;
-            p.y += dy;
-        } else {
+        if (!grid(p.x + dx, p.y + dy, p.z + dz)) {
             p = npos;
             break;
         }
+        p.x += dx;
+        p.y += dy;
+        p.z += dz;
+        a = ~b;
+        ++steps;
     }
     stepsDone += steps;
     stepsRemain -= steps;
     return p;
 }
 
-// 跳跃x轴
+// 平面对角线跳跃（两个轴）。检查第三个轴上的强制邻居，然后沿两个分量做直线跳跃。
 template <typename GRID>
-inline Position Searcher<GRID>::jumpX(Position p, int dx) {
-    JPS_ASSERT(dx);
-    JPS_ASSERT(grid(p.x, p.y));
-    const PosType y = p.y;
+Position Searcher<GRID>::jumpD2(Position p, int dx, int dy, int dz) {
+    JPS_ASSERT(grid(p.x, p.y, p.z));
     const Position endpos = endPos;
     unsigned steps = 0;
-    unsigned a = ~((!!grid(p.x, y + 1)) | ((!!grid(p.x, y - 1)) << 1));
     while (true) {
-        const unsigned xx = p.x + dx;
-        const unsigned b = (!!grid(xx, y + 1)) | ((!!grid(xx, y - 1)) << 1);
-        if ((b & a) || p == endpos)
+        if (p == endpos)
             break;
-        if (!grid(xx, y)) {
+        ++steps;
+        const PosType x = p.x, y = p.y, z = p.z;
+        if (forcedD2(x, y, z, dx, dy, dz))
+            break;
+        if (dx && grid(x + dx, y, z) && jumpS(Pos(x + dx, y, z), dx, 0, 0).isValid())
+            break;
+        if (dy && grid(x, y + dy, z) && jumpS(Pos(x, y + dy, z), 0, dy, 0).isValid())
+            break;
+        if (dz && grid(x, y, z + dz) && jumpS(Pos(x, y, z + dz), 0, 0, dz).isValid())
+            break;
+        if (!canMove(x, y, z, dx, dy, dz)) {
             p = npos;
             break;
         }
         p.x += dx;
-        a = ~b;
-        ++steps;
+        p.y += dy;
+        p.z += dz;
     }
     stepsDone += steps;
     stepsRemain -= steps;
     return p;
 }
 
-// 跳跃y轴
+// 空间对角线跳跃（三个轴）。没有强制邻居；沿3个平面对角线和3个轴做子跳跃。
 template <typename GRID>
-inline Position Searcher<GRID>::jumpY(Position p, int dy) {
-    JPS_ASSERT(dy);
-    JPS_ASSERT(grid(p.x, p.y));
-    const PosType x = p.x;
+Position Searcher<GRID>::jumpD3(Position p, int dx, int dy, int dz) {
+    JPS_ASSERT(grid(p.x, p.y, p.z));
     const Position endpos = endPos;
     unsigned steps = 0;
-    unsigned a = ~((!!grid(x + 1, p.y)) | ((!!grid(x - 1, p.y)) << 1));
     while (true) {
-        const unsigned yy = p.y + dy;
-        const unsigned b = (!!grid(x + 1, yy)) | ((!!grid(x - 1, yy)) << 1);
-        if ((a & b) || p == endpos)
+        if (p == endpos)
             break;
-        if (!grid(x, yy)) {
+        ++steps;
+        const PosType x = p.x, y = p.y, z = p.z;
+        if (canMove(x, y, z, dx, dy, 0) && jumpD2(Pos(x + dx, y + dy, z), dx, dy, 0).isValid())
+            break;
+        if (canMove(x, y, z, dx, 0, dz) && jumpD2(Pos(x + dx, y, z + dz), dx, 0, dz).isValid())
+            break;
+        if (canMove(x, y, z, 0, dy, dz) && jumpD2(Pos(x, y + dy, z + dz), 0, dy, dz).isValid())
+            break;
+        if (grid(x + dx, y, z) && jumpS(Pos(x + dx, y, z), dx, 0, 0).isValid())
+            break;
+        if (grid(x, y + dy, z) && jumpS(Pos(x, y + dy, z), 0, dy, 0).isValid())
+            break;
+        if (grid(x, y, z + dz) && jumpS(Pos(x, y, z + dz), 0, 0, dz).isValid())
+            break;
+        if (!canMove(x, y, z, dx, dy, dz)) {
             p = npos;
             break;
         }
+        p.x += dx;
         p.y += dy;
-        a = ~b;
-        ++steps;
+        p.z += dz;
     }
     stepsDone += steps;
     stepsRemain -= steps;
     return p;
 }
-#define JPS_CHECKGRID(dx, dy) (grid(x + (dx), y + (dy)))
-
-// 添加邻居
-#define JPS_ADDPOS(dx, dy)              \
-    do {                                \
-        *w++ = Pos(x + (dx), y + (dy)); \
-    } while (0)
-
-// 添加邻居，防止穿墙
-#define JPS_ADDPOS_CHECK(dx, dy)   \
-    do {                           \
-        if (JPS_CHECKGRID(dx, dy)) \
-            JPS_ADDPOS(dx, dy);    \
-    } while (0)
 
-// 添加邻居，防止穿墙
-#define JPS_ADDPOS_NO_TUNNEL(dx, dy)                \
-    do {                                            \
-        if (grid(x + (dx), y) || grid(x, y + (dy))) \
-            JPS_ADDPOS_CHECK(dx, dy);               \
+#define JPS3D_ADDPOS_CHECK(dx, dy, dz)             \
+    do {                                           \
+        if (canMove(x, y, z, (dx), (dy), (dz)))    \
+            *w++ = Pos(x + (dx), y + (dy), z + (dz)); \
     } while (0)
 
-// 返回邻居数量
+// 返回邻居数量，最多26个
 template <typename GRID>
 unsigned Searcher<GRID>::findNeighborsJPS(const Node& n, Position* wptr) const {
     Position* w = wptr;
-    const unsigned x = n.pos.x;
-    const unsigned y = n.pos.y;
+    const PosType x = n.pos.x;
+    const PosType y = n.pos.y;
+    const PosType z = n.pos.z;
     if (!n.hasParent()) {
-        // straight moves
-        JPS_ADDPOS_CHECK(-1, 0); // 添加左邻居
-        JPS_ADDPOS_CHECK(0, -1); // 添加上邻居
-        JPS_ADDPOS_CHECK(0, 1); // 添加右邻居
-        JPS_ADDPOS_CHECK(1, 0); // 添加下邻居
-        // diagonal moves + prevent tunneling
-        JPS_ADDPOS_NO_TUNNEL(-1, -1); // 添加左上角邻居
-        JPS_ADDPOS_NO_TUNNEL(-1, 1); // 添加左下角邻居
-        JPS_ADDPOS_NO_TUNNEL(1, -1); // 添加右上角邻居
-        JPS_ADDPOS_NO_TUNNEL(1, 1); // 添加右下角邻居
+        for (int dz = -1; dz <= 1; ++dz)
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx)
+                    if (dx || dy || dz)
+                        JPS3D_ADDPOS_CHECK(dx, dy, dz);
         return unsigned(w - wptr);
     }
-    const Node& p = n.getParent(); // 获取父节点
-    // jump directions (both -1, 0, or 1)
-    const int dx = Sgn<int>(x - p.pos.x); // 计算x轴方向
-    const int dy = Sgn<int>(y - p.pos.y); // 计算y轴方向
-    if (dx && dy) { // 如果x轴和y轴方向都存在
-        // 对角线方向
-        // 自然邻居
-        const bool walkX = !!grid(x + dx, y); // 判断x轴方向是否可行走
-        if (walkX)
-            *w++ = Pos(x + dx, y); // 添加x轴方向的邻居
-        const bool walkY = !!grid(x, y + dy); // 判断y轴方向是否可行走
-        if (walkY)
-            *w++ = Pos(x, y + dy); // 添加y轴方向的邻居
-        if (walkX || walkY)
-            JPS_ADDPOS_CHECK(dx, dy); // 添加对角线方向的邻居
-        // 强制邻居
-        if (walkY && !JPS_CHECKGRID(-dx, 0))
-            JPS_ADDPOS_CHECK(-dx, dy);
-        if (walkX && !JPS_CHECKGRID(0, -dy))
-            JPS_ADDPOS_CHECK(dx, -dy);
-    } else if (dx) {
-        // 沿x轴
-        if (JPS_CHECKGRID(dx, 0)) {
-            JPS_ADDPOS(dx, 0);
-            // 强制邻居（+防止穿墙）
-            if (!JPS_CHECKGRID(0, 1))
-                JPS_ADDPOS_CHECK(dx, 1);
-            if (!JPS_CHECKGRID(0, -1))
-                JPS_ADDPOS_CHECK(dx, -1);
+    const Node& p = n.getParent();
+    const int dx = JPS::Sgn<int>(x - p.pos.x);
+    const int dy = JPS::Sgn<int>(y - p.pos.y);
+    const int dz = JPS::Sgn<int>(z - p.pos.z);
+    // 自然邻居：移动方向的所有子方向
+    for (int c = 0; c <= !!dz; ++c)
+        for (int b = 0; b <= !!dy; ++b)
+            for (int a = 0; a <= !!dx; ++a)
+                if (a || b || c)
+                    JPS3D_ADDPOS_CHECK(a * dx, b * dy, c * dz);
+    // 强制邻居：侧向移动在当前格子可行、而在上一个格子不可行
+    const PosType px = x - dx, py = y - dy, pz = z - dz;
+    switch (!!dx + !!dy + !!dz) {
+        case 1: {
+            const int ux = !!dz, uy = !!dx, uz = !!dy;
+            const int vx = !!dy, vy = !!dz, vz = !!dx;
+            const unsigned forced = sideMask(x, y, z, dx, dy, dz) & ~sideMask(px, py, pz, dx, dy, dz);
+            if (forced) {
+                static const signed char su[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+                static const signed char sv[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+                for (unsigned i = 0; i < 8; ++i)
+                    if (forced & (1u << i)) {
+                        const int sx = su[i] * ux + sv[i] * vx;
+                        const int sy = su[i] * uy + sv[i] * vy;
+                        const int sz = su[i] * uz + sv[i] * vz;
+                        JPS3D_ADDPOS_CHECK(sx, sy, sz);
+                        JPS3D_ADDPOS_CHECK(sx + dx, sy + dy, sz + dz);
+                    }
+            }
+            break;
         }
-    } else if (dy) {
-        // 沿y轴
-        if (JPS_CHECKGRID(0, dy)) {
-            JPS_ADDPOS(0, dy);
-            // 强制邻居（+防止穿墙）
-            if (!JPS_CHECKGRID(1, 0))
-                JPS_ADDPOS_CHECK(1, dy);
-            if (!JPS_CHECKGRID(-1, 0))
-                JPS_ADDPOS_CHECK(-1, dy);
+        case 2: {
+            const int cx = !dx, cy = !dy, cz = !dz;  // 第三个轴
+            // 两个非零分量A和B
+            const int ax = dx, ay = dx ? 0 : dy, az = 0;
+            const int bx = 0, by = dx ? dy : 0, bz = dz;
+            const unsigned forced = forcedD2(x, y, z, dx, dy, dz);
+            for (int s = -1; s <= 1; s += 2) {
+                const int sx = s * cx, sy = s * cy, sz = s * cz;
+                if (forced & (s > 0 ? 1 : 2)) {
+                    // 侧向移动，以及它与移动方向各子方向的组合
+                    for (int b = 0; b <= 1; ++b)
+                        for (int a = 0; a <= 1; ++a)
+                            JPS3D_ADDPOS_CHECK(sx + a * ax + b * bx, sy + a * ay + b * by, sz + a * az + b * bz);
+                }
+            }
+            break;
         }
     }
     return unsigned(w - wptr);
 }
-//-------------- Plain old A* search ----------------
+
 template <typename GRID>
 unsigned Searcher<GRID>::findNeighborsAStar(const Node& n, Position* wptr) {
     Position* w = wptr;
-    const int x = n.pos.x;
-    const int y = n.pos.y;
-    const int d = 1;
-    JPS_ADDPOS_NO_TUNNEL(-d, -d); // 添加左上角邻居
-    JPS_ADDPOS_CHECK(0, -d); // 添加正上方邻居  
-    JPS_ADDPOS_NO_TUNNEL(+d, -d); // 添加右上角邻居
-    JPS_ADDPOS_CHECK(-d, 0); // 添加左方邻居
-    JPS_ADDPOS_CHECK(+d, 0); // 添加右方邻居
-    JPS_ADDPOS_NO_TUNNEL(-d, +d); // 添加左下角邻居
-    JPS_ADDPOS_CHECK(0, +d); // 添加正下方邻居
-    JPS_ADDPOS_NO_TUNNEL(+d, +d); // 添加右下角邻居
-    stepsDone += 8; // 步数加8
-    return unsigned(w - wptr); // 返回邻居数量
+    const PosType x = n.pos.x;
+    const PosType y = n.pos.y;
+    const PosType z = n.pos.z;
+    for (int dz = -1; dz <= 1; ++dz)
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx)
+                if (dx || dy || dz)
+                    JPS3D_ADDPOS_CHECK(dx, dy, dz);
+    stepsDone += 26;
+    return unsigned(w - wptr);
 }
-//-------------------------------------------------
-#undef JPS_ADDPOS
-#undef JPS_ADDPOS_CHECK
-#undef JPS_ADDPOS_NO_TUNNEL
-#undef JPS_CHECKGRID
+#undef JPS3D_ADDPOS_CHECK
 
-// 识别后继节点
 template <typename GRID>
 bool Searcher<GRID>::identifySuccessors(const Node& n_) {
     const SizeT nidx = storage.getindex(&n_);
     const Position np = n_.pos;
-    Position buf[8]; // 邻居数组，最多8个邻居
-    const int num = (flags & JPS_Flag_AStarOnly) ? findNeighborsAStar(n_, &buf[0]) : findNeighborsJPS(n_, &buf[0]); // 获取邻居数量
+    Position buf[26];
+    const int num = (flags & JPS_Flag_AStarOnly) ? findNeighborsAStar(n_, &buf[0]) : findNeighborsJPS(n_, &buf[0]);
     for (int i = num - 1; i >= 0; --i) {
-        // 不变性：一个节点只有在对应的网格位置是可行走的时才是有效的邻居（在jumpP中被断言）
         Position jp;
         if (flags & JPS_Flag_AStarOnly)
-            jp = buf[i]; // 如果使用A*算法，则直接使用邻居
+            jp = buf[i];
         else {
-            jp = jumpP(buf[i], np); // 跳跃到目标位置
+            jp = jumpP(buf[i], np);
             if (!jp.isValid())
-                continue; // 如果跳跃后的位置无效，则跳过
+                continue;
         }
-        // 现在网格位置肯定是有效的跳点，我们必须创建实际的节点。
         Node* jn = getNode(jp);  // 这可能会重新分配存储
         if (!jn)
-            return false;  // 内存不足
-        Node& n = storage[nidx];  // 在重新分配的情况下获取有效的引用
+            return false;
+        Node& n = storage[nidx];
         JPS_ASSERT(jn != &n);
-        if (!jn->isClosed())
-            _expandNode(jp, *jn, n);
+        if (!jn->isClosed() || (flags & JPS_Flag_MovingTarget))
+            _expandNode<JPS::DefaultPolicy>(jp, *jn, n);
     }
     return true;
 }
+
 template <typename GRID>
 template <typename PV>
 bool Searcher<GRID>::findPath(PV& path, Position start, Position end, unsigned step, JPS_Flags flags) {
     JPS_Result res = findPathInit(start, end, flags);
-    // 如果这是真的，结果路径是空的（findPathFinish()会失败，所以这需要在检查之前）
     if (res == JPS_EMPTY_PATH)
         return true;
     while (true) {
-        switch (res) { 
+        switch (res) {
             case JPS_NEED_MORE_STEPS:
-                res = findPathStep(0); // 步数不足，继续搜索
-                break;  // 开关
+                res = findPathStep(0);
+                break;
             case JPS_FOUND_PATH:
                 return findPathFinish(path, step) == JPS_FOUND_PATH;
             case JPS_EMPTY_PATH:
@@ -1115,44 +3984,58 @@ bool Searcher<GRID>::findPath(PV& path, Position start, Position end, unsigned s
                 // fall through
             case JPS_NO_PATH:
             case JPS_OUT_OF_MEMORY:
+            case JPS_BUDGET_EXCEEDED:
                 return false;
         }
     }
 }
+
 template <typename GRID>
 JPS_Result Searcher<GRID>::findPathInit(Position start, Position end, JPS_Flags flags) {
-    // 这仅重置几个计数器；容器内存未触及
+    this->template _mtLearn<JPS::DefaultPolicy>();
+    if (flags & JPS_Flag_MovingTarget) {
+        ScoreType moveCost = -1;
+        Position mid[2];
+        unsigned nmid;
+        if (!mtGoal.isValid() || end == mtGoal)
+            moveCost = 0;
+        else if (findDirectPath(end, mtGoal, mid, nmid)) {
+            Position last = end;
+            moveCost = 0;
+            for (unsigned i = 0; i < nmid; last = mid[i++])
+                moveCost += JPS::DefaultPolicy::Accurate(last, mid[i]);
+            moveCost += JPS::DefaultPolicy::Accurate(last, mtGoal);
+        }
+        this->_mtMoveGoal(end, moveCost);
+    }
     this->clear();
     this->flags = flags;
     endPos = end;
-    // FIXME: 检查这个
-    if (start == end && !(flags & (JPS_Flag_NoStartCheck | JPS_Flag_NoEndCheck))) {
-        // 只有当这个单个位置是可行走的时才有路径。
-        // 但由于起始位置在输出中被省略，这里没有什么可做的。
-        return grid(end.x, end.y) ? JPS_EMPTY_PATH : JPS_NO_PATH;
-    }
-    if (!(flags & JPS_Flag_NoStartCheck)) // 如果不需要检查起始位置
-        if (!grid(start.x, start.y)) // 如果起始位置不可行走
-            return JPS_NO_PATH; // 返回找不到路径
-    if (!(flags & JPS_Flag_NoEndCheck)) // 如果不需要检查目标位置
-        if (!grid(end.x, end.y))
+    if (start == end && !(flags & (JPS_Flag_NoStartCheck | JPS_Flag_NoEndCheck)))
+        return grid(end.x, end.y, end.z) ? JPS_EMPTY_PATH : JPS_NO_PATH;
+    if (!(flags & JPS_Flag_NoStartCheck))
+        if (!grid(start.x, start.y, start.z))
             return JPS_NO_PATH;
-    Node* endNode = getNode(end);  // 这可能会重新分配内部存储...
+    if (!(flags & JPS_Flag_NoEndCheck))
+        if (!grid(end.x, end.y, end.z))
+            return JPS_NO_PATH;
+    Node* endNode = getNode(end);
     if (!endNode)
-        return JPS_OUT_OF_MEMORY;
-    endNodeIdx = storage.getindex(endNode);  // .. 所以我们保留这个以便稍后使用
-    Node* startNode = getNode(start);  // 这可能会重新分配
+        return mem.failResult();
+    endNodeIdx = storage.getindex(endNode);
+    Node* startNode = getNode(start);
     if (!startNode)
-        return JPS_OUT_OF_MEMORY;
-    endNode = &storage[endNodeIdx];  // startNode是有效的，确保endNode也是有效的，以防我们重新分配
+        return mem.failResult();
+    endNode = &storage[endNodeIdx];
     if (!(flags & JPS_Flag_NoGreedy)) {
-        // 先尝试快速方法
         if (findPathGreedy(startNode, endNode))
             return JPS_FOUND_PATH;
     }
+    startNode->setOpen();  // 移动目标模式中已关闭的节点也会被扩展，起点不能被当作新节点
     open.pushNode(startNode);
     return JPS_NEED_MORE_STEPS;
 }
+
 template <typename GRID>
 JPS_Result Searcher<GRID>::findPathStep(int limit) {
     stepsRemain = limit;
@@ -1163,109 +4046,80 @@ JPS_Result Searcher<GRID>::findPathStep(int limit) {
         n.setClosed();
         if (n.pos == endPos)
             return JPS_FOUND_PATH;
-        if (!identifySuccessors(n)) // 识别后继节点
-            return JPS_OUT_OF_MEMORY;
+        if (!identifySuccessors(n))
+            return mem.failResult();
     } while (stepsRemain >= 0);
     return JPS_NEED_MORE_STEPS;
 }
+
 template <typename GRID>
 template <typename PV>
 JPS_Result Searcher<GRID>::findPathFinish(PV& path, unsigned step) const {
     return this->generatePath(path, step);
 }
-// 贪心算法
+
+// 贪心：先沿空间对角线，再沿平面对角线，最后沿轴移动。最多两个中间路径点。
 template <typename GRID>
-bool Searcher<GRID>::findPathGreedy(Node* n, Node* endnode) {
-    Position midpos = npos;                // 中间位置
-    PosType x = n->pos.x;                  // 起始位置x
-    PosType y = n->pos.y;                  // 起始位置y
-    const Position endpos = endnode->pos;  // 目标位置
-    JPS_ASSERT(x != endpos.x || y != endpos.y);  // 起始位置和目标位置不能相同
-    JPS_ASSERT(n != endnode);                    // 起始节点和目标节点不能相同
-    int dx = int(endpos.x - x);  // 目标位置x - 起始位置x
-    int dy = int(endpos.y - y);  // 目标位置y - 起始位置y
-    const int adx = Abs(dx);     // 目标位置x - 起始位置x的绝对值
-    const int ady = Abs(dy);     // 目标位置y - 起始位置y的绝对值
-    dx = Sgn(dx);                // 目标位置x - 起始位置x的符号
-    dy = Sgn(dy);                // 目标位置y - 起始位置y的符号
-    // 首先沿对角线移动
-    if (x != endpos.x && y != endpos.y) {
-        JPS_ASSERT(dx && dy);                // 确保dx和dy不为0，为0则表示在同一行或同一列
-        const int minlen = Min(adx, ady);    // 取dx和dy的最小值
-        const PosType tx = x + dx * minlen;  // 计算目标位置x
-        while (x != tx) {
-            if (grid(x, y) && (grid(x + dx, y) || grid(x, y + dy)))  // 防止穿墙
-            {
-                x += dx;
-                y += dy;
-            } else
-                return false;
+bool Searcher<GRID>::findDirectPath(Position p, const Position& endpos, Position* mid, unsigned& nmid) const {
+    JPS_ASSERT(p != endpos);
+    nmid = 0;
+    int ldx = 0, ldy = 0, ldz = 0;
+    while (p != endpos) {
+        const int dx = JPS::Sgn(int(endpos.x - p.x));
+        const int dy = JPS::Sgn(int(endpos.y - p.y));
+        const int dz = JPS::Sgn(int(endpos.z - p.z));
+        if ((ldx || ldy || ldz) && (dx != ldx || dy != ldy || dz != ldz)) {
+            JPS_ASSERT(nmid < 2);
+            mid[nmid++] = p;  // 方向改变
         }
-        if (!grid(x, y)) // 如果中间位置不可行走
-            return false; // 返回找不到路径
-        midpos = Pos(x, y); // 设置中间位置
-    }
-    // 此时，我们沿至少一个轴对齐
-    JPS_ASSERT(x == endpos.x || y == endpos.y); // 确保x和y至少有一个等于endpos.x或endpos.y
-    if (!(x == endpos.x && y == endpos.y)) { // 如果x和y不等于endpos.x和endpos.y
-        while (x != endpos.x) // 沿x轴移动
-            if (!grid(x += dx, y)) // 如果移动后的位置不可行走
-                return false; // 返回找不到路径
-        while (y != endpos.y) // 沿y轴移动
-            if (!grid(x, y += dy))
-                return false;
-        JPS_ASSERT(x == endpos.x && y == endpos.y);
+        if (!canMove(p, dx, dy, dz))
+            return false;
+        p.x += dx;
+        p.y += dy;
+        p.z += dz;
+        ldx = dx;
+        ldy = dy;
+        ldz = dz;
     }
-    if (midpos.isValid()) { // 如果中间位置有效
-        const unsigned nidx = storage.getindex(n); // 获取中间位置的索引
-        Node* mid = getNode(midpos);  // 获取中间位置的节点
-        if (!mid)
+    return true;
+}
+template <typename GRID>
+bool Searcher<GRID>::findPathGreedy(Node* n, Node* endnode) {
+    Position mid[2];
+    unsigned nmid;
+    if (!findDirectPath(n->pos, endnode->pos, mid, nmid))
+        return false;
+    const SizeT nidx = storage.getindex(n);
+    SizeT previdx = nidx;
+    for (unsigned i = 0; i < nmid; ++i) {
+        Node* m = getNode(mid[i]);
+        if (!m)
             return false;
-        n = &storage[nidx];  // 重新加载指针
-        endnode = &storage[endNodeIdx]; // 重新加载目标节点
-        JPS_ASSERT(mid && mid != n); // 确保中间节点和起始节点不同
-        mid->setParent(*n); // 设置中间节点的父节点为起始节点
-        if (mid != endnode) // 如果中间节点不等于目标节点
-            endnode->setParent(*mid); // 设置目标节点的父节点为中间节点
-    } else
-        endnode->setParent(*n); // 如果中间位置无效，设置目标节点的父节点为起始节点
-    return true; // 返回找到路径
+        JPS_ASSERT(storage.getindex(m) != previdx);
+        m->setParent(storage[previdx]);
+        previdx = storage.getindex(m);
+    }
+    storage[endNodeIdx].setParent(storage[previdx]);
+    return true;
 }
-#undef JPS_ASSERT
-#undef JPS_realloc
-#undef JPS_free
-#undef JPS_sqrt
-#undef JPS_HEURISTIC_ACCURATE
-#undef JPS_HEURISTIC_ESTIMATE
-}  // end namespace Internal
-using Internal::Searcher;
-typedef Internal::PodVec<Position> PathVector;
-// 单次调用便利函数。为了效率，不要在需要重复计算路径时使用这个函数。
-//
-// 返回：0如果失败或无法找到路径，否则为步数。
-//
-// path: 如果函数返回成功，路径将被附加到这个向量中。
-//       路径不包含起始位置，即如果起始位置和结束位置相同，结果路径将没有元素。
-//       向量不必为空。函数不清除它；相反，新路径位置被附加到末尾。
-//       这允许增量构建路径。
-//
-// grid: 仿函数，预期重载operator()(x, y)，如果位置可行走，返回true，否则返回false。
-//
-// step: 如果为0，仅返回路径点。
-//       如果为1，创建详尽的步进路径。
-//       如果为N，将N个块的距离或当到达路径点时放入一个位置。
-//       所有返回的位置都保证在一条直线上（垂直、水平或对角线），并且任何两个连续位置之间没有障碍。
-//       注意，此参数不会影响路径搜索；它仅控制输出路径的粗细。
+
+// 单次调用便利函数，参见2D版本的JPS::findPath()。
 template <typename GRID, typename PV>
-SizeT findPath(PV& path, const GRID& grid, PosType startx, PosType starty, PosType endx, PosType endy,
+SizeT findPath(PV& path, const GRID& grid, Position start, Position end,
                unsigned step = 0,  // optional
                JPS_Flags flags = JPS_Flag_Default,
                void* user = 0)  // memory allocation userdata
 {
     Searcher<GRID> search(grid, user);
-    if (!search.findPath(path, Pos(startx, starty), Pos(endx, endy), step, flags))
+    if (!search.findPath(path, start, end, step, flags))
         return 0;
     const SizeT done = search.getStepsDone();
-    return done + !done;  // report at least 1 step; as 0 would indicate failure
+    return done + !done;
 }
-}  // end namespace JPS
+}  // end namespace JPS3D
+#undef JPS_ASSERT
+#undef JPS_realloc
+#undef JPS_free
+#undef JPS_sqrt
+#undef JPS_HEURISTIC_ACCURATE
+#undef JPS_HEURISTIC_ESTIMATE
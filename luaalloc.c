@@ -15,14 +15,25 @@ Background:
   malloc() & friends tend to be rather slow and also add some bytes of overhead for bookkeeping (typically 8 or 16 bytes),
   so a large percentage of the actually allocated memory is wasted.
   This allocator groups allocations of the same (small) size into blocks and passes through larger allocations.
+  Medium allocations (up to a few KiB: Lua table parts, closures, mid-sized strings) are grouped the same way,
+  in coarser size classes.
   Small allocations have an overhead of 1 bit plus some bookkeeping information for each block.
-  This allocator is also rather fast; in the typical case a block known to contain free slots is cached,
-  and inside of this block, finding a free slot is a tiny loop checking 32 slots at once,
-  followed by a CTZ (count trailing zeros) to locate the exact slot out of the 32.
-  Freeing is similar, first do a binary search to locate the block containing the pointer to be freed,
+  This allocator is also rather fast; each size bin keeps a list of its blocks that have free slots,
+  allocations are served from the first one, and inside of this block, finding a free slot takes two CTZs (count trailing zeros):
+  one on a summary word that has a bit set for each bitmap word with free slots, then one on that bitmap word of 64 slots.
+  Blocks are not requested from the system one by one; they are carved out of fixed-size superblocks,
+  each split into pages. Every superblock has a table that maps each of its pages to the block occupying it.
+  Freeing is similar, first locate the superblock containing the pointer to be freed (a hash table lookup by address),
+  look up the block in its page table,
   then flip the bit for that slot to mark it as unused. (Bitmap position and bit index is computed from the address, no loop there.)
-  Once a block for a given size bin is full, other blocks in this bin are filled. A new block is allocated from the system if there is no free block.
-  Unused blocks are free()d as soon as they are completely empty.
+  None of this depends on the number of blocks or superblocks, and neither does creating or destroying a superblock.
+  A block leaves its bin's list when it becomes full and re-enters at the front when one of its slots is freed,
+  so finding a block with a free slot never needs a search. A new block is allocated if the list is empty.
+  A few completely empty blocks per size bin are kept for reuse, so that a bin hovering around a block boundary
+  doesn't create and destroy a block every time. Kept blocks that stay unneeded for a while are released one by one,
+  and luaalloc_trim() releases all of them at once.
+  Released blocks return their pages to their superblock;
+  a superblock is free()d when all of its pages are unused (except for one that is kept as a spare).
 
 Origin:
   https://github.com/fgenesis/tinypile/blob/master/luaalloc.c
@@ -58,32 +69,56 @@ Inspired by:
    If the default sysalloc is disabled, symbols for realloc()/free() won't be pulled in. */
 #define LA_ENABLE_DEFAULT_ALLOC
 
-/* Maximum size of allocations to handle. Any size beyond that will be redirected to the system allocator.
-   Must be a multiple of LA_ALLOC_STEP */
+/* Maximum size of small allocations. Sizes up to this are served from bins LA_ALLOC_STEP bytes apart.
+   Must be a multiple of LA_ALLOC_STEP and a power of 2 */
 #define LA_MAX_ALLOC 128
 
+/* Medium allocations above LA_MAX_ALLOC are served from blocks as well, in 4 size classes per power of 2
+   (160, 192, 224, 256, 320, ...), up to LA_MAX_ALLOC doubled this many times (default: 4 KiB).
+   Any size beyond that will be redirected to the system allocator. 0 disables the medium tier. */
+#define LA_MEDIUM_DOUBLINGS 5
+
+/* Initial # of elements per block for medium size classes (instead of LA_ELEMS_MIN) */
+#define LA_MEDIUM_ELEMS_MIN 8
+
 /* Provide pools in increments of this size, up to LA_MAX_ALLOC. 4 or 8 are good values. */
 /* E.g. A value of 4 will create pools for size 4, 8, 12, ... 128; which is 32 distinct sizes. */
 #define LA_ALLOC_STEP 4
 
 /* Initial/Max. # of elements per block. Default growing behavior is to double the size for each full block until hitting LA_ELEMS_MAX.
-   Note that each element requires 1 bit in the bitmap, the number of elements is rounded up so that no bit is unused,
+   Note that each element requires 1 bit in the bitmap, the number of small elements is rounded so that no bit is unused,
    and the bitmap array is sized accordingly. Best is to use powers of 2. */
 #define LA_ELEMS_MIN 64
-#define LA_ELEMS_MAX 2048 /* Stored in u16, don't go higher than 0x8000 */
+#define LA_ELEMS_MAX 2048 /* Stored in u16; also limited by the summary bitmap to 64 bitmap words (4096 with u64 words) */
 #define LA_GROW_BLOCK_SIZE(n) (n * 2)
 
+/* Number of empty blocks each size bin keeps for reuse instead of releasing them. 0 releases blocks as soon as they are empty. */
+#define LA_KEEP_EMPTY_BLOCKS 2
+
+/* Kept empty blocks decay: After this many small frees, each bin that didn't need one of its kept blocks
+   in the meantime releases one. */
+#define LA_DECAY_INTERVAL 4096
+
+/* Blocks are allocated from superblocks of this many bytes, which are requested from the system allocator.
+   A superblock is split into pages of LA_PAGE_SIZE bytes; the first page holds the superblock header,
+   and each block occupies a run of the remaining pages. A block is as large as its size bin's growth
+   calls for, but never larger than a superblock minus its header page.
+   Both must be powers of 2, and a superblock must not have more than 64 usable pages. */
+#define LA_SUPERBLOCK_SIZE (64 * 1024)
+#define LA_PAGE_SIZE 1024
+
 typedef unsigned int u32;
 typedef unsigned short u16;
+typedef unsigned long long u64;
 
-/* Bitmap type. Default u32. If you want to use another unsigned type (e.g. uint64_t)
+/* Bitmap type. Default u64. If you want to use another unsigned type (e.g. u32)
    you must provide a count-trailing-zeroes function.
    Note that the bitmap implicitly controls the data alignment -- the data area starts directly after the bitmap array,
    there is no explicit padding in between. */
-typedef u32 ubitmap;
+typedef u64 ubitmap;
 
 /* CTZ for your bitmap type. */
-#define bitmap_CTZ(x) ctz32(x)
+#define bitmap_CTZ(x) ctz64(x)
 
 /* ---- Configuration end ---- */
 
@@ -134,11 +169,27 @@ inline static unsigned ctz32(u32 x)
 #endif
 }
 
+inline static unsigned ctz64(u64 x)
+{
+#if defined(HAS_BUILTIN_CTZ)
+    return __builtin_ctzll(x);
+#else
+    const u32 lo = (u32)x;
+    return lo ? ctz32(lo) : 32 + ctz32((u32)(x >> 32));
+#endif
+}
+
 /* ---- Structs for internal book-keeping ---- */
 
-#define BLOCK_ARRAY_SIZE  (LA_MAX_ALLOC / LA_ALLOC_STEP)
+#define SMALL_BINS  (LA_MAX_ALLOC / LA_ALLOC_STEP)
+#define MEDIUM_BINS (4 * LA_MEDIUM_DOUBLINGS)
+#define MEDIUM_MAX  (LA_MAX_ALLOC << LA_MEDIUM_DOUBLINGS) /* largest size served from blocks */
+#define BLOCK_ARRAY_SIZE  (SMALL_BINS + MEDIUM_BINS)
+
+#define SUPERBLOCK_PAGES ((LA_SUPERBLOCK_SIZE / LA_PAGE_SIZE) - 1) /* usable pages, page 0 is the header */
 
 typedef struct Block Block;
+typedef struct Superblock Superblock;
 
 struct Block
 {
@@ -146,21 +197,69 @@ struct Block
     u16 elemstotal;  /* const */
     u16 elemSize;    /* const */
     u16 bitmapInts;  /* const */
-    Block *next;     /* dynamic */
-    Block *prev;     /* dynamic */
+    Block *next;     /* dynamic, next block with free slots in this bin */
+    Block *prev;     /* dynamic, previous block with free slots in this bin */
+    Superblock *super; /* const */
+    u64 summary;     /* dynamic, bit i is set if bitmap[i] has a free slot */
 
     ubitmap bitmap[1];
     /* bitmap area */
     /* data area */
 };
 
+struct Superblock
+{
+    Block *owner[SUPERBLOCK_PAGES]; /* block occupying each page, NULL if the page is unused */
+    u64 freepages; /* bit i is set if page i is unused */
+    unsigned numfree; /* number of unused pages */
+    unsigned maxrun; /* length of the longest run of unused pages, selects the list this superblock is in */
+    Superblock *next; /* dynamic, next superblock with the same longest run */
+    Superblock *prev; /* dynamic, previous superblock with the same longest run */
+    /* rest of the header page is unused */
+    /* pages */
+};
+
+/* The header must fit into the first page, and the page bitmap must fit into a u64 */
+typedef char superblock_header_check[(sizeof(Superblock) <= LA_PAGE_SIZE && SUPERBLOCK_PAGES <= 64) ? 1 : -1];
+
+/* Medium size classes split powers of 2 into quarters */
+typedef char max_alloc_check[(LA_MAX_ALLOC % LA_ALLOC_STEP == 0 && (LA_MAX_ALLOC & (LA_MAX_ALLOC - 1)) == 0 && LA_MAX_ALLOC >= 4 * LA_ALLOC_STEP) ? 1 : -1];
+
+/* A block has at most 64 bitmap words, one for each bit of its summary */
+typedef char elems_max_check[(LA_ELEMS_MAX <= 64 * sizeof(ubitmap) * CHAR_BIT) ? 1 : -1];
+
+#define BLOCK_HEADER_SIZE (sizeof(Block) - sizeof(ubitmap)) /* block header without bitmap[1] */
+
+/* Element sizes are stored in u16, and the first block of the largest medium bin (header, one bitmap word and
+   LA_MEDIUM_ELEMS_MIN elements) must fit into the usable pages of a superblock */
+typedef char medium_check[(MEDIUM_MAX <= 0xffff && LA_MEDIUM_ELEMS_MIN <= sizeof(ubitmap) * CHAR_BIT
+    && BLOCK_HEADER_SIZE + sizeof(ubitmap) + (size_t)MEDIUM_MAX * LA_MEDIUM_ELEMS_MIN <= LA_SUPERBLOCK_SIZE - LA_PAGE_SIZE) ? 1 : -1];
+
+/* Superblocks are found by address through a hash table. The key is the address divided by LA_SUPERBLOCK_SIZE
+   (a "window"); superblocks are not aligned to their size, so each one covers up to two windows,
+   and each window is covered by up to two superblocks (the end of one and the start of the next). */
+typedef struct MapEntry
+{
+    size_t window;
+    Superblock *sb[2]; /* Superblocks overlapping the window, NULL if unused. Both NULL: entry is empty */
+} MapEntry;
+
 typedef struct LuaAlloc
 {
-    Block *active[BLOCK_ARRAY_SIZE]; /* current work block for each size, that serves allocations until full */
-    Block *chain[BLOCK_ARRAY_SIZE]; /* newest allocated block for each size (follow ->prev to get older block) */
-    Block **all; /* All blocks in use, sorted by address */
-    size_t allnum; /* number of blocks in use */
-    size_t allcap; /* capacity of array */
+    Block *partial[BLOCK_ARRAY_SIZE]; /* blocks with at least one free slot for each size (follow ->next), the first serves allocations */
+    unsigned numblocks[BLOCK_ARRAY_SIZE]; /* number of blocks for each size, including kept empty ones */
+    Block *empty[BLOCK_ARRAY_SIZE]; /* kept empty blocks for each size (follow ->next) */
+    unsigned numempty[BLOCK_ARRAY_SIZE]; /* number of kept empty blocks for each size */
+    unsigned char emptyused[BLOCK_ARRAY_SIZE]; /* whether a kept block was reused since the last decay */
+    unsigned decaycount; /* small frees since the last decay */
+    MapEntry *map; /* Open addressing with linear probing, NULL if no superblock was ever allocated */
+    size_t mapcap; /* number of entries, power of 2 */
+    size_t mapused; /* number of non-empty entries */
+    size_t numsuper; /* number of superblocks in use */
+    Superblock *withrun[SUPERBLOCK_PAGES]; /* superblocks whose longest run of unused pages is [i]+1 pages (follow ->next) */
+    u64 runmask; /* bit i is set if withrun[i] is not empty */
+    Superblock *lastfree; /* superblock that contained the last freed pointer, checked first */
+    Superblock *spare; /* one completely unused superblock is kept instead of freed, NULL if there is none */
     LuaSysAlloc sysalloc;
     void *user;
 #ifdef LA_TRACK_STATS
@@ -193,10 +292,29 @@ inline static void *getdataend(Block *b)
     return ((char*)getdata(b)) + ((size_t)b->elemSize * b->elemstotal);
 }
 
-inline static unsigned sizeindex(u16 elemSize)
+inline static unsigned sizeindex(size_t size)
+{
+    LA_ASSERT(size && size <= MEDIUM_MAX);
+    if(size <= LA_MAX_ALLOC)
+        return (unsigned)((size - 1) / LA_ALLOC_STEP);
+
+    /* Medium: find the power of 2 range (lim, 2*lim] that has the size, then which quarter of it */
+    unsigned si = SMALL_BINS;
+    size_t lim = LA_MAX_ALLOC;
+    for( ; size > lim * 2; lim *= 2)
+        si += 4;
+    return si + (unsigned)((size - lim - 1) / (lim / 4));
+}
+
+/* Element size of a bin; the largest size that goes into it */
+inline static u16 binsize(unsigned si)
 {
-    LA_ASSERT(elemSize && elemSize <= LA_MAX_ALLOC);
-    return (elemSize - 1) / LA_ALLOC_STEP;
+    LA_ASSERT(si < BLOCK_ARRAY_SIZE);
+    if(si < SMALL_BINS)
+        return (u16)((si + 1) * LA_ALLOC_STEP);
+    si -= SMALL_BINS;
+    const unsigned lim = LA_MAX_ALLOC << (si / 4);
+    return (u16)(lim + ((si % 4) + 1) * (lim / 4));
 }
 
 inline static unsigned bsizeindex(const Block *b)
@@ -209,6 +327,23 @@ static int contains(Block * b, const void *p)
     return getdata(b) <= p && p < getdataend(b);
 }
 
+inline static char *getpage(Superblock *sb, unsigned i)
+{
+    return ((char*)sb) + ((size_t)(i + 1) * LA_PAGE_SIZE);
+}
+
+inline static unsigned pageindex(Superblock *sb, const void *p)
+{
+    const size_t offs = (const char*)p - (const char*)sb;
+    LA_ASSERT(offs >= LA_PAGE_SIZE && offs < LA_SUPERBLOCK_SIZE);
+    return (unsigned)(offs / LA_PAGE_SIZE) - 1;
+}
+
+inline static int insuper(Superblock *sb, const void *p)
+{
+    return (const char*)sb < (const char*)p && (const char*)p < ((const char*)sb) + LA_SUPERBLOCK_SIZE;
+}
+
 inline static u16 roundToFullBitmap(u16 n) 
 {
 #if CHAR_BIT == 8
@@ -221,10 +356,13 @@ inline static u16 roundToFullBitmap(u16 n)
 inline static void checkblock(Block *b)
 {
     LA_ASSERT(b->elemSize && (b->elemSize % LA_ALLOC_STEP) == 0);
-    LA_ASSERT(b->bitmapInts * BITMAP_ELEM_SIZE == b->elemstotal);
+    LA_ASSERT(b->elemSize == binsize(bsizeindex(b)));
+    LA_ASSERT(b->elemSize <= LA_MAX_ALLOC ? b->bitmapInts * BITMAP_ELEM_SIZE == b->elemstotal /* no unused bits */
+        : (b->elemstotal + BITMAP_ELEM_SIZE - 1) / BITMAP_ELEM_SIZE == b->bitmapInts);
     LA_ASSERT(b->elemsfree <= b->elemstotal);
-    LA_ASSERT(b->elemstotal >= LA_ELEMS_MIN);
+    LA_ASSERT(b->elemstotal >= (b->elemSize <= LA_MAX_ALLOC ? LA_ELEMS_MIN : 1));
     LA_ASSERT(b->elemstotal <= LA_ELEMS_MAX);
+    LA_ASSERT(b->bitmapInts <= 64); /* One summary bit per bitmap word */
 }
 
 inline static size_t blocksize(Block *b)
@@ -232,11 +370,21 @@ inline static size_t blocksize(Block *b)
     return (char*)getdataend(b) - (char*)b;
 }
 
-inline static u16 nextblockelems(Block *b)
+
+inline static unsigned blockpagesfor(u16 nelems, u16 elemsz)
+{
+    const size_t size = BLOCK_HEADER_SIZE
+        + ((nelems + BITMAP_ELEM_SIZE - 1) / BITMAP_ELEM_SIZE) * sizeof(ubitmap) /* actual bitmap size */
+        + (nelems * (size_t)elemsz);                    /* data size */
+    return (unsigned)((size + LA_PAGE_SIZE - 1) / LA_PAGE_SIZE);
+}
+
+/* Grow once for each block that already exists in the bin */
+inline static u16 nextblockelems(unsigned si, unsigned nblocks)
 {
-    if(!b)
-        return LA_ELEMS_MIN;
-    u32 n = LA_GROW_BLOCK_SIZE(b->elemstotal);
+    u32 n = si < SMALL_BINS ? LA_ELEMS_MIN : LA_MEDIUM_ELEMS_MIN;
+    for(unsigned i = 0; i < nblocks && n < LA_ELEMS_MAX; ++i)
+        n = LA_GROW_BLOCK_SIZE(n);
     return (u16)(n < LA_ELEMS_MAX ? n : LA_ELEMS_MAX);
 }
 
@@ -269,143 +417,374 @@ inline static void *sysrealloc(LuaAlloc * LA_RESTRICT LA, void * LA_RESTRICT p,
 
 /* ---- Allocator internals ---- */
 
-static Block *_allocblock(LuaAlloc *LA, u16 nelems, u16 elemsz)
+inline static size_t windowof(const void *p)
 {
-    elemsz = ((elemsz + LA_ALLOC_STEP-1) / LA_ALLOC_STEP) * LA_ALLOC_STEP; /* round up */
-    nelems = roundToFullBitmap(nelems); /* The bitmap array must not have any unused bits */
-    const u16 nbitmap = nelems / BITMAP_ELEM_SIZE;
+    return (size_t)p / LA_SUPERBLOCK_SIZE;
+}
 
-    void *ptr = sysmalloc(LA, LA_TYPE_BLOCK,
-          (sizeof(Block) - sizeof(ubitmap)) /* block header without bitmap[1] */
-        + (nbitmap * sizeof(ubitmap))       /* actual bitmap size */
-        + (nelems * (size_t)elemsz)         /* data size */
-    );
+inline static size_t maphome(const LuaAlloc *LA, size_t window)
+{
+    return (size_t)(((u64)window * 0x9E3779B97F4A7C15ull) >> 32) & (LA->mapcap - 1); /* Fibonacci hashing */
+}
 
-    if(!ptr)
+inline static int mapempty(const MapEntry *e)
+{
+    return !e->sb[0] && !e->sb[1];
+}
+
+static MapEntry *mapfind(LuaAlloc *LA, size_t window)
+{
+    if(!LA->map)
         return NULL;
+    const size_t mask = LA->mapcap - 1;
+    for(size_t i = maphome(LA, window); ; i = (i + 1) & mask)
+    {
+        MapEntry *e = &LA->map[i];
+        if(mapempty(e))
+            return NULL;
+        if(e->window == window)
+            return e;
+    }
+}
 
-    Block *b = (Block*)ptr;
-    b->elemsfree = nelems;
-    b->elemstotal = nelems;
-    b->elemSize = elemsz;
-    b->bitmapInts = nbitmap;
-    b->next = NULL;
-    b->prev = NULL;
-    LA_MEMSET(b->bitmap, -1, nbitmap * sizeof(ubitmap)); /* mark all as free */
+/* Returns the entry for window, creating it if it doesn't exist. There must be room for it. */
+static MapEntry *mapget(LuaAlloc *LA, size_t window)
+{
+    LA_ASSERT(LA->mapused < LA->mapcap);
+    const size_t mask = LA->mapcap - 1;
+    for(size_t i = maphome(LA, window); ; i = (i + 1) & mask)
+    {
+        MapEntry *e = &LA->map[i];
+        if(mapempty(e))
+        {
+            e->window = window;
+            ++LA->mapused;
+            return e;
+        }
+        if(e->window == window)
+            return e;
+    }
+}
 
-    return b;
+/* Empty an entry, and move later entries of the same probe sequence back so that no lookup stops early */
+static void mapremove(LuaAlloc * LA_RESTRICT LA, MapEntry * LA_RESTRICT e)
+{
+    const size_t mask = LA->mapcap - 1;
+    size_t i = e - LA->map;
+    for(size_t j = (i + 1) & mask; !mapempty(&LA->map[j]); j = (j + 1) & mask)
+    {
+        const size_t k = maphome(LA, LA->map[j].window);
+        /* Entry j may move to the hole at i if its home slot is not cyclically within (i, j] */
+        if(i <= j ? (k <= i || k > j) : (k <= i && k > j))
+        {
+            LA->map[i] = LA->map[j];
+            i = j;
+        }
+    }
+    LA->map[i].sb[0] = NULL;
+    LA->map[i].sb[1] = NULL;
+    --LA->mapused;
 }
 
-/* Given the sorting order of LA->all, find the right spot to insert p that preserves the sorting order.
-   Returns the address of the block that is <= p, or one past the end if no such block was found.
-   Use cases:
-   1) Pass a block to get the address where this block is stored
-   2) Pass any other pointer to get ONE BLOCK PAST the address of the block that would contain it (this is not checked)
-*/
-static Block **findspot(LuaAlloc * LA_RESTRICT LA, void * LA_RESTRICT p)
+/* Make sure at least n more entries can be added while keeping the table at most half full. Returns 0 if out of memory. */
+static int mapreserve(LuaAlloc *LA, size_t n)
+{
+    if((LA->mapused + n) * 2 <= LA->mapcap)
+        return 1;
+
+    size_t newcap = LA->mapcap ? LA->mapcap * 2 : 64;
+    while((LA->mapused + n) * 2 > newcap)
+        newcap *= 2;
+    MapEntry *newmap = (MapEntry*)sysmalloc(LA, LA_TYPE_INTERNAL, newcap * sizeof(MapEntry));
+    if(!newmap)
+        return 0;
+    LA_MEMSET(newmap, 0, newcap * sizeof(MapEntry));
+
+    MapEntry *oldmap = LA->map;
+    const size_t oldcap = LA->mapcap;
+    LA->map = newmap;
+    LA->mapcap = newcap;
+    LA->mapused = 0;
+    for(size_t i = 0; i < oldcap; ++i)
+        if(!mapempty(&oldmap[i]))
+            *mapget(LA, oldmap[i].window) = oldmap[i];
+    if(oldmap)
+        sysfree(LA, oldmap, oldcap * sizeof(MapEntry));
+    return 1;
+}
+
+/* Returns the superblock containing p, or NULL if p is not inside any superblock */
+static Superblock *findsuper(LuaAlloc * LA_RESTRICT LA, const void * LA_RESTRICT p)
+{
+    Superblock *sb = LA->lastfree;
+    if(sb && insuper(sb, p)) /* Good case: Frees tend to come in runs from the same area */
+        return sb;
+
+    const MapEntry *e = mapfind(LA, windowof(p));
+    if(!e)
+        return NULL;
+    if(e->sb[0] && insuper(e->sb[0], p))
+        sb = e->sb[0];
+    else if(e->sb[1] && insuper(e->sb[1], p))
+        sb = e->sb[1];
+    else
+        return NULL;
+    LA->lastfree = sb;
+    return sb;
+}
+
+/* ---- Superblocks by longest run of unused pages (intrusive lists) ---- */
+
+/* Full superblocks (maxrun == 0) are not in any list */
+static void linkfree(LuaAlloc * LA_RESTRICT LA, Superblock * LA_RESTRICT sb)
 {
-    Block **all = LA->all;
+    const unsigned r = sb->maxrun;
+    if(!r)
+        return;
+    sb->prev = NULL;
+    sb->next = LA->withrun[r - 1];
+    if(sb->next)
+        sb->next->prev = sb;
+    LA->withrun[r - 1] = sb;
+    LA->runmask |= (u64)1 << (r - 1);
+}
 
-    /* Binary search to find leftmost element */
-    size_t L = 0;
-    size_t R = LA->allnum;
-    while(L < R)
+static void unlinkfree(LuaAlloc * LA_RESTRICT LA, Superblock * LA_RESTRICT sb)
+{
+    const unsigned r = sb->maxrun;
+    if(!r)
+        return;
+    if(sb->prev)
+        sb->prev->next = sb->next;
+    else
     {
-        size_t m = (L + R) / 2u;
-        if((void*)all[m] < p)
-            L = m + 1;
-        else
-            R = m;
+        LA_ASSERT(LA->withrun[r - 1] == sb);
+        if(!(LA->withrun[r - 1] = sb->next))
+            LA->runmask &= ~((u64)1 << (r - 1));
     }
-    return all + L;
+    if(sb->next)
+        sb->next->prev = sb->prev;
+}
+
+/* Length of the longest run of set bits in m */
+static unsigned longestrun(u64 m)
+{
+    unsigned n = 0;
+    for( ; m; ++n)
+        m &= m >> 1; /* Every run loses its top bit */
+    return n;
 }
 
-static size_t enlarge(LuaAlloc *LA)
+/* Move sb to the right list after its unused pages changed */
+static void updaterun(LuaAlloc * LA_RESTRICT LA, Superblock * LA_RESTRICT sb)
 {
-    const size_t incr = (LA->allcap / 2) + 16;
-    const size_t newcap = LA->allcap + incr; /* Rough guess */
-    Block **newall = (Block**)sysrealloc(LA, LA->all, LA->all ? LA->allcap : LA_TYPE_INTERNAL, sizeof(Block*) * newcap);
-    if(newall)
+    const unsigned r = longestrun(sb->freepages);
+    if(r != sb->maxrun)
     {
-        LA->all = newall;
-        LA->allcap = newcap;
-        return newcap;
+        unlinkfree(LA, sb);
+        sb->maxrun = r;
+        linkfree(LA, sb);
     }
-    return 0;
 }
 
-static Block *insertblock(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b)
+static Superblock *newsuper(LuaAlloc *LA)
 {
-    /* Enlarge central block storage if necessary */
-    if(LA->allcap == LA->allnum && !enlarge(LA))
-    { 
-        sysfree(LA, b, blocksize(b)); /* Can't fit block, kill it and fail */
+    /* Room for the (at most) two windows this superblock covers */
+    if(!mapreserve(LA, 2))
         return NULL;
-    }
 
-    /* Find correct spot to insert */
-    /* Invariant: Array is already sorted */
-    Block **spot = findspot(LA, b);
-    Block **end = LA->all + LA->allnum;
+    Superblock *sb = (Superblock*)sysmalloc(LA, LA_TYPE_BLOCK, LA_SUPERBLOCK_SIZE);
+    if(!sb)
+        return NULL;
 
-    /* inserting in the middle? Must preserve sort order */
-    if(spot < end)
+    LA_MEMSET(sb->owner, 0, sizeof(sb->owner));
+    sb->freepages = ((u64)-1) >> (64 - SUPERBLOCK_PAGES); /* mark all as unused */
+    sb->numfree = SUPERBLOCK_PAGES;
+    sb->maxrun = SUPERBLOCK_PAGES;
+    linkfree(LA, sb);
+
+    /* The superblock is the upper neighbour in the window it starts in, and the lower one in the window it ends in */
+    const size_t w0 = windowof(sb), w1 = windowof(((char*)sb) + LA_SUPERBLOCK_SIZE - 1);
+    MapEntry *e = mapget(LA, w0);
+    LA_ASSERT(!e->sb[1]);
+    e->sb[1] = sb;
+    if(w1 != w0)
     {
-        /* move other pointers up */
-        LA_MEMMOVE(spot+1, spot, (end - spot) * sizeof(Block*));
+        e = mapget(LA, w1);
+        LA_ASSERT(!e->sb[0]);
+        e->sb[0] = sb;
     }
 
-    *spot = b;
-    ++LA->allnum;
+    ++LA->numsuper;
+    return sb;
+}
 
-    /* Link in chain */
-    const unsigned si = bsizeindex(b);
-    Block *top = LA->chain[si];
-    LA->chain[si] = b;
-    if(top)
+static void freesuper(LuaAlloc * LA_RESTRICT LA, Superblock * LA_RESTRICT sb)
+{
+    LA_ASSERT(LA->numsuper);
+    LA_ASSERT(sb->numfree == SUPERBLOCK_PAGES);
+
+    const size_t w0 = windowof(sb), w1 = windowof(((char*)sb) + LA_SUPERBLOCK_SIZE - 1);
+    MapEntry *e = mapfind(LA, w0);
+    LA_ASSERT(e && e->sb[1] == sb);
+    e->sb[1] = NULL;
+    if(mapempty(e))
+        mapremove(LA, e);
+    if(w1 != w0)
     {
-        LA_ASSERT(!top->next);
-        top->next = b;
+        e = mapfind(LA, w1); /* Look up again, removing an entry may have moved others */
+        LA_ASSERT(e && e->sb[0] == sb);
+        e->sb[0] = NULL;
+        if(mapempty(e))
+            mapremove(LA, e);
     }
-    b->prev = top;
 
-#ifdef LA_TRACK_STATS
-    LA->stats.blocks_alive[si]++;
-#endif
+    unlinkfree(LA, sb);
+    --LA->numsuper;
 
-    checkblock(b);
+    if(LA->lastfree == sb)
+        LA->lastfree = NULL;
+    if(LA->spare == sb)
+        LA->spare = NULL;
 
-    return b;
+    sysfree(LA, sb, LA_SUPERBLOCK_SIZE);
 }
 
-static void freeblock(LuaAlloc * LA_RESTRICT LA, Block ** LA_RESTRICT spot)
+/* Returns the index of the first run of n set bits in m, or -1 if there is none */
+static int findrun(u64 m, unsigned n)
 {
-    LA_ASSERT(LA->allnum);
-    Block *b = *spot;
-    checkblock(b);
+    u64 x = m;
+    for(unsigned i = 1; i < n && x; ++i)
+        x &= m >> i; /* Bit k stays set only if bits k..k+i are all set */
+    return x ? (int)ctz64(x) : -1;
+}
 
-    /* Remove from central list */
-    Block **end = LA->all + LA->allnum;
-    if(spot+1 < end)
+/* Reserve a run of npages unused pages, in an existing superblock if possible. Stores the superblock in *psb.
+   Returns the first page of the run, or NULL if a new superblock was needed but couldn't be allocated.
+   Takes a superblock with the shortest longest run that fits, so that long runs stay available for large blocks. */
+static void *allocpages(LuaAlloc * LA_RESTRICT LA, unsigned npages, Superblock ** LA_RESTRICT psb)
+{
+    LA_ASSERT(npages && npages <= SUPERBLOCK_PAGES);
+    Superblock *sb;
+    int first;
+    const u64 fits = LA->runmask >> (npages - 1); /* bit i: some superblock has a longest run of npages+i */
+    if(fits)
     {
-        /* Move other pointers down */
-        LA_MEMMOVE(spot, spot+1, (end - (spot+1)) * sizeof(Block*));
+        sb = LA->withrun[npages - 1 + ctz64(fits)];
+        first = findrun(sb->freepages, npages);
+        LA_ASSERT(first >= 0);
+    }
+    else
+    {
+        if(!(sb = newsuper(LA)))
+            return NULL;
+        first = 0;
     }
-    --LA->allnum;
-    /* Invariant: Array is still sorted after removing an element */
 
-    /* Remove from chain */
-    unsigned si = bsizeindex(b);
-    if(LA->chain[si] == b)
+    sb->freepages &= ~((((u64)1 << npages) - 1) << first); /* npages < 64, so this doesn't overflow */
+    sb->numfree -= npages;
+    updaterun(LA, sb);
+    if(LA->spare == sb)
+        LA->spare = NULL;
+    *psb = sb;
+    return getpage(sb, first);
+}
+
+/* Give the pages of a dying block back to its superblock. Frees the superblock if it is now completely unused. */
+static void freepages(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b)
+{
+    Superblock *sb = b->super;
+    const unsigned first = pageindex(sb, b);
+    const unsigned npages = blockpagesfor(b->elemstotal, b->elemSize);
+    for(unsigned i = 0; i < npages; ++i)
+    {
+        LA_ASSERT(sb->owner[first + i] == b);
+        sb->owner[first + i] = NULL;
+    }
+    sb->freepages |= (((u64)1 << npages) - 1) << first;
+    sb->numfree += npages;
+    updaterun(LA, sb);
+    if(sb->numfree == SUPERBLOCK_PAGES)
     {
-        LA_ASSERT(!b->next);
-        LA->chain[si] = b->prev;
+        /* Keep one unused superblock around, so that a single block being created and dropped over and over
+           doesn't go to the system allocator every time */
+        if(!LA->spare)
+            LA->spare = sb;
+        else if(LA->spare != sb)
+            freesuper(LA, sb);
     }
+}
+
+/* elemsz must be the size of a bin */
+static Block *_allocblock(LuaAlloc *LA, u16 nelems, u16 elemsz)
+{
+    const int small = elemsz <= LA_MAX_ALLOC;
+    if(small)
+        nelems = roundToFullBitmap(nelems); /* The bitmap array must not have any unused bits */
+
+    unsigned npages = blockpagesfor(nelems, elemsz);
+    if(npages > SUPERBLOCK_PAGES)
+        npages = SUPERBLOCK_PAGES;
+
+    /* Use up the pages: as many elements as fit, counting 1 bitmap bit each.
+       Keep the count of small elements a multiple of LA_ELEMS_MIN, as the default growth does.
+       Medium blocks have few elements, their last bitmap word may have unused bits. */
+    size_t fit = ((npages * (size_t)LA_PAGE_SIZE - BLOCK_HEADER_SIZE) * CHAR_BIT) / ((size_t)elemsz * CHAR_BIT + 1);
+    if(small)
+        fit = (fit / LA_ELEMS_MIN) * LA_ELEMS_MIN;
+    if(fit > LA_ELEMS_MAX)
+        fit = LA_ELEMS_MAX;
+    while(blockpagesfor((u16)fit, elemsz) > npages) /* The bitmap is rounded up to whole words */
+        --fit;
+    LA_ASSERT(fit);
+    nelems = (u16)fit;
+    npages = blockpagesfor(nelems, elemsz); /* Less than before if LA_ELEMS_MAX was hit */
+    const u16 nbitmap = (nelems + BITMAP_ELEM_SIZE - 1) / BITMAP_ELEM_SIZE;
+
+    Superblock *sb;
+    void *ptr = allocpages(LA, npages, &sb);
+    if(!ptr)
+        return NULL;
+
+    Block *b = (Block*)ptr;
+    b->elemsfree = nelems;
+    b->elemstotal = nelems;
+    b->elemSize = elemsz;
+    b->bitmapInts = nbitmap;
+    b->next = NULL;
+    b->prev = NULL;
+    b->super = sb;
+    LA_MEMSET(b->bitmap, -1, nbitmap * sizeof(ubitmap)); /* mark all as free */
+    if(nelems % BITMAP_ELEM_SIZE)
+        b->bitmap[nbitmap - 1] = ((ubitmap)1 << (nelems % BITMAP_ELEM_SIZE)) - 1; /* unused bits stay '0' (= used) */
+    b->summary = nbitmap < 64 ? ((u64)1 << nbitmap) - 1 : ~(u64)0;
 
-    if(LA->active[si] == b)
-        LA->active[si] = NULL;
+    const unsigned first = pageindex(sb, b);
+    LA_ASSERT(blocksize(b) <= npages * (size_t)LA_PAGE_SIZE);
+    for(unsigned i = 0; i < npages; ++i)
+        sb->owner[first + i] = b;
 
-    /* Unlink from linked list */
+    return b;
+}
+
+/* Put a block that has free slots at the front of its bin's list */
+static void linkpartial(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b)
+{
+    LA_ASSERT(b->elemsfree);
+    const unsigned si = bsizeindex(b);
+    Block *top = LA->partial[si];
+    b->prev = NULL;
+    b->next = top;
+    if(top)
+    {
+        LA_ASSERT(!top->prev);
+        top->prev = b;
+    }
+    LA->partial[si] = b;
+}
+
+static void unlinkpartial(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b)
+{
     if(b->next)
     {
         LA_ASSERT(b->next->prev == b);
@@ -416,12 +795,74 @@ static void freeblock(LuaAlloc * LA_RESTRICT LA, Block ** LA_RESTRICT spot)
         LA_ASSERT(b->prev->next == b);
         b->prev->next = b->next;
     }
+    else
+    {
+        LA_ASSERT(LA->partial[bsizeindex(b)] == b);
+        LA->partial[bsizeindex(b)] = b->next;
+    }
+}
+
+static Block *insertblock(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b)
+{
+    const unsigned si = bsizeindex(b);
+    linkpartial(LA, b);
+    LA->numblocks[si]++;
+
+#ifdef LA_TRACK_STATS
+    LA->stats.blocks_alive[si]++;
+#endif
+
+    checkblock(b);
+
+    return b;
+}
+
+/* The block must not be in any list */
+static void freeblock(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b)
+{
+    checkblock(b);
+
+    const unsigned si = bsizeindex(b);
+    LA->numblocks[si]--;
 
 #ifdef LA_TRACK_STATS
     LA->stats.blocks_alive[si]--;
 #endif
 
-    sysfree(LA, b, blocksize(b)); /* free it */
+    freepages(LA, b); /* free it */
+}
+
+static void keepempty(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b)
+{
+    LA_ASSERT(b->elemsfree == b->elemstotal);
+    const unsigned si = bsizeindex(b);
+    b->prev = NULL;
+    b->next = LA->empty[si];
+    LA->empty[si] = b;
+    LA->numempty[si]++;
+}
+
+static Block *takeempty(LuaAlloc *LA, unsigned si)
+{
+    Block *b = LA->empty[si];
+    if(b)
+    {
+        LA->empty[si] = b->next;
+        LA->numempty[si]--;
+    }
+    return b;
+}
+
+/* Release one kept block from each bin that didn't need them lately */
+static void decay(LuaAlloc *LA)
+{
+    LA->decaycount = 0;
+    for(unsigned si = 0; si < BLOCK_ARRAY_SIZE; ++si)
+    {
+        if(!LA->emptyused[si] && LA->numempty[si])
+            freeblock(LA, takeempty(LA, si));
+        LA->emptyused[si] = 0;
+    }
 }
 
 static Block *newblock(LuaAlloc *LA, u16 nelems, u16 elemsz)
@@ -434,13 +875,17 @@ static void *_Balloc(Block *b)
 {
     LA_ASSERT(b->elemsfree);
     ubitmap *bitmap = b->bitmap;
-    unsigned i = 0, bm;
-    for( ; !(bm = bitmap[i]); ++i) {} /* as soon as one isn't all zero, there's a free slot */
-    LA_ASSERT(i < b->bitmapInts); /* And there must've been a free slot because b->elemsfree != 0 */
+    LA_ASSERT(b->summary); /* There must be a free slot because b->elemsfree != 0 */
+    const unsigned i = ctz64(b->summary); /* First bitmap word that isn't all zero */
+    LA_ASSERT(i < b->bitmapInts);
+    ubitmap bm = bitmap[i];
+    LA_ASSERT(bm);
     ubitmap bitIdx = bitmap_CTZ(bm); /* Get exact location of free slot */
     LA_ASSERT(bm & ((ubitmap)1 << bitIdx)); /* make sure this is '1' (= free) */
     bm &= ~((ubitmap)1 << bitIdx); /* put '0' where '1' was (-> mark as non-free) */
     bitmap[i] = bm;
+    if(!bm)
+        b->summary &= ~((u64)1 << i); /* That was the last free slot in this word */
     --b->elemsfree;
     const size_t where = (i * (size_t)BITMAP_ELEM_SIZE) + bitIdx;
     void *ret = ((char*)getdata(b)) + (where * b->elemSize);
@@ -460,6 +905,7 @@ static void _Bfree(Block * LA_RESTRICT b, void * LA_RESTRICT p)
     LA_ASSERT(bitmapIdx < b->bitmapInts);
     LA_ASSERT(!(b->bitmap[bitmapIdx] & ((ubitmap)1 << bitIdx))); /* make sure this is '0' (= used) */
     b->bitmap[bitmapIdx] |= ((ubitmap)1 << bitIdx); /* put '1' where '0' was (-> mark as free) */
+    b->summary |= (u64)1 << bitmapIdx;
     ++b->elemsfree;
 }
 
@@ -467,30 +913,27 @@ static void _Bfree(Block * LA_RESTRICT b, void * LA_RESTRICT p)
 static Block *getfreeblock(LuaAlloc *LA, u16 size)
 {
     unsigned si = sizeindex(size);
-    Block *b = LA->active[si];
-    if(b && b->elemsfree) /* Good case: Currently active block is free, use that */
+    Block *b = LA->partial[si];
+    if(b) /* Good case: Every block in the list has free slots */
         return b;
 
-    /* Not-so-good case: Active block is full or doesn't exist, try an older block in the chain */
-    b = LA->chain[si];
-    while(b && !b->elemsfree)
-        b = b->prev;
-
-    /* Still no good? Allocate new block */
-    if(!b || !b->elemsfree)
-        b = newblock(LA, nextblockelems(LA->chain[si]), size); /* Use newest block in chain to compute size */
-
-    /* Use this block for further allocation requests */
-    LA->active[si] = b;
+    /* Not-so-good case: All blocks are full, reuse a kept empty block */
+    if((b = takeempty(LA, si)))
+    {
+        LA->emptyused[si] = 1;
+        linkpartial(LA, b);
+        return b;
+    }
 
-    return b;
+    /* Still no good? Allocate a new one */
+    return newblock(LA, nextblockelems(si, LA->numblocks[si]), binsize(si));
 }
 
 static void *_Alloc(LuaAlloc *LA, size_t size)
 {
     LA_ASSERT(size);
 
-    if(size <= LA_MAX_ALLOC)
+    if(size <= MEDIUM_MAX)
     {
         Block *b = getfreeblock(LA, (u16)size);
         if(b)
@@ -498,6 +941,8 @@ static void *_Alloc(LuaAlloc *LA, size_t size)
             checkblock(b);
             void *p = _Balloc(b);
             LA_ASSERT(p); /* Can't fail -- block was known to be free */
+            if(!b->elemsfree)
+                unlinkpartial(LA, b); /* Just became full */
 
 #ifdef LA_TRACK_STATS
             unsigned si = bsizeindex(b);
@@ -521,37 +966,54 @@ static void *_Alloc(LuaAlloc *LA, size_t size)
     return p;
 }
 
-static void freefromspot(LuaAlloc * LA_RESTRICT LA, Block ** LA_RESTRICT spot, void *p)
+static void freefromblock(LuaAlloc * LA_RESTRICT LA, Block * LA_RESTRICT b, void *p)
 {
-    Block *b = *spot;
 #ifdef LA_TRACK_STATS
     unsigned si = bsizeindex(b);
     LA->stats.alive[si]--;
 #endif
+    if(++LA->decaycount >= LA_DECAY_INTERVAL)
+        decay(LA);
+
     if(b->elemsfree + 1 == b->elemstotal)
-        freeblock(LA, spot); /* Freeing last element in the block -> just free the whole thing */
+    {
+        /* Freeing last element in the block -> keep it if the bin has room for it, otherwise free the whole thing */
+        unlinkpartial(LA, b);
+        if(LA->numempty[bsizeindex(b)] < LA_KEEP_EMPTY_BLOCKS)
+        {
+            _Bfree(b, p);
+            keepempty(LA, b);
+        }
+        else
+            freeblock(LA, b);
+    }
     else
+    {
+        const int wasfull = !b->elemsfree;
         _Bfree(b, p);
+        if(wasfull)
+            linkpartial(LA, b); /* Has a free slot again */
+    }
 }
 
 static void _Free(LuaAlloc * LA_RESTRICT LA , void * LA_RESTRICT p, size_t oldsize)
 {
     LA_ASSERT(p);
 
-    if(oldsize <= LA_MAX_ALLOC)
+    if(oldsize <= MEDIUM_MAX)
     {
-        Block **spot = findspot(LA, p); /* Here, spot might point one past the end */
-        spot -= (spot > LA->all); /* One back unless we're already at the front -- now spot is always valid */
-        Block *b = *spot;
-        checkblock(b);
-        if(contains(b, p))
+        Superblock *sb = findsuper(LA, p);
+        if(sb)
         {
-            freefromspot(LA, spot, p);
+            Block *b = sb->owner[pageindex(sb, p)];
+            LA_ASSERT(b && contains(b, p)); /* Every pointer inside a superblock was handed out by one of its blocks */
+            checkblock(b);
+            freefromblock(LA, b, p);
             return;
         }
-        /* else p is outside of any block area. This case is unlikely but possible:
+        /* else p is outside of any superblock. This case is unlikely but possible:
            - alloc large size (falling through to system alloc),
-           - then, try to shrink it to fit inside LA_MAX_ALLOC,
+           - then, try to shrink it to fit inside MEDIUM_MAX,
            - ... but there is no block free for that size...
            - try to alloc new block and fail (out of memory)
            - then _Realloc() uses the original, still valid pointer since by spec shrink requests must not fail
@@ -570,6 +1032,12 @@ static void _Free(LuaAlloc * LA_RESTRICT LA , void * LA_RESTRICT p, size_t oldsi
 static void *_Realloc(LuaAlloc * LA_RESTRICT LA, void * LA_RESTRICT p, size_t newsize, size_t oldsize)
 {
     LA_ASSERT(p);
+
+    /* Same bin, and p is inside a block: its slot is already large enough. (Not so for a pointer from the system allocator,
+       which may be exactly oldsize large.) Lua grows and shrinks arrays and strings in small steps, which this skips. */
+    if(oldsize <= MEDIUM_MAX && newsize <= MEDIUM_MAX && sizeindex(oldsize) == sizeindex(newsize) && findsuper(LA, p))
+        return p;
+
     void *newptr = _Alloc(LA, newsize);
 
     /* If the new allocation failed, just re-use the old pointer if it was a shrink request.
@@ -641,11 +1109,26 @@ LuaAlloc * luaalloc_create(LuaSysAlloc sysalloc, void *user)
     return LA;
 }
 
+size_t luaalloc_trim(LuaAlloc *LA)
+{
+    const size_t before = LA->numsuper;
+    for(unsigned si = 0; si < BLOCK_ARRAY_SIZE; ++si)
+    {
+        Block *b;
+        while((b = takeempty(LA, si)))
+            freeblock(LA, b);
+    }
+    if(LA->spare)
+        freesuper(LA, LA->spare);
+    return (before - LA->numsuper) * LA_SUPERBLOCK_SIZE;
+}
+
 void luaalloc_delete(LuaAlloc *LA)
 {
-    LA_ASSERT(LA->allnum == 0); /* If this fails the Lua state didn't GC everything, which is a bug */
-    if(LA->all)
-        sysfree(LA, LA->all, LA->allcap * sizeof(Block*));
+    luaalloc_trim(LA);
+    LA_ASSERT(LA->numsuper == 0); /* If this fails the Lua state didn't GC everything, which is a bug */
+    if(LA->map)
+        sysfree(LA, LA->map, LA->mapcap * sizeof(MapEntry));
     sysfree(LA, LA, sizeof(LuaAlloc)); /* free self */
 }
 
@@ -675,6 +1158,11 @@ unsigned luaalloc_getstats(const LuaAlloc *LA, const size_t ** alive, const size
 #endif
 }
 
+unsigned luaalloc_binsize(unsigned bin)
+{
+    return bin < BLOCK_ARRAY_SIZE ? binsize(bin) : 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
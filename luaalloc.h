@@ -12,6 +12,8 @@ Usage:
 
 #pragma once
 
+#include <stddef.h> /* for size_t */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -35,13 +37,20 @@ LuaAlloc *luaalloc_create(LuaSysAlloc sysalloc, void *ud);
 /* Destroy allocator. Call after lua_close()ing each Lua state using the allocator. */
 void luaalloc_delete(LuaAlloc*);
 
+/* Release memory that is kept around for reuse (empty blocks, and an unused superblock) back to the system allocator.
+   This happens gradually on its own; call this e.g. after a full GC cycle to do it right away.
+   Returns the number of bytes handed back to the system allocator. */
+size_t luaalloc_trim(LuaAlloc*);
+
 /* Statistics tracking. Define LA_TRACK_STATS in luaalloc.c to use this. [Enabled by default in debug mode].
    Provides pointers to internal stats area. Each element corresponds to an internal allocation bin.
    - alive: How many allocations of a bin size are currently in use.
    - total: How many allocations of a bin size were ever made.
    - blocks: How many blocks currently exist for a bin.
-   With the default config, index 0 corresponds to all allocations of 1-4 bytes, index 1 to those of 5-8 bytes, and so on.
-   The bin size increment is returned in pbinstep (default: 4).
+   With the default config, index 0 corresponds to all allocations of 1-4 bytes, index 1 to those of 5-8 bytes, and so on
+   up to 128 bytes; the bins after that are medium size classes, 4 per power of 2 (129-160, 161-192, ... up to 4096 bytes).
+   Use luaalloc_binsize() to get the size range of a bin.
+   The small bin size increment is returned in pbinstep (default: 4).
    All output pointers can be NULL if you're not interested in the thing.
    Returns the total number of bins. 0 when stats tracking is disabled.
    The last valid index is not an actual bin -- instead, large allocations that bypass the allocator are collected there.
@@ -49,17 +58,21 @@ void luaalloc_delete(LuaAlloc*);
    To iterate over the size bins, you can do:
 
     const size_t *alive, *total, *blocks;
-    unsigned step, n = luaalloc_getstats(LA, &alive, &total, &blocks, &step);
+    unsigned n = luaalloc_getstats(LA, &alive, &total, &blocks, NULL);
     if(n)
     {
-        for(unsigned i = 0, a = 1, b = step; i < n-1; ++i, a = b+1, b += step)
+        for(unsigned i = 0, a = 1; i < n-1; a = luaalloc_binsize(i++) + 1)
             printf("%zu blocks of %u..%u bytes: %zu allocations alive, %zu done all-time\n",
-                    blocks[i],    a,  b,        alive[i],              total[i]);
+                    blocks[i],    a,  luaalloc_binsize(i), alive[i],   total[i]);
         printf("large allocations: %zu alive, %zu done all-time\n", alive[n-1], total[n-1]);
     }
 */
 unsigned luaalloc_getstats(const LuaAlloc*, const size_t **alive, const size_t **total, const size_t **blocks, unsigned *pbinstep);
 
+/* Largest allocation size that goes into bin #bin, as indexed by luaalloc_getstats(). 0 for the last index (large allocations).
+   Works regardless of stats tracking. */
+unsigned luaalloc_binsize(unsigned bin);
+
 #ifdef __cplusplus
 }
 #endif
@@ -90,9 +103,9 @@ switch(osize)
     case LUAALLOC_TYPE_LARGELUA:
         passthrough/large Lua allocation (alloc'd/free'd/realloc'd incl. shrink requests)
     case LUAALLOC_TYPE_BLOCK:
-        block allocation (alloc'd/free'd, but never realloc'd)
+        superblock allocation, blocks are carved out of these (always the same size, 64 KiB by default. alloc'd/free'd, but never realloc'd)
     case LUAALLOC_TYPE_INTERNAL:
-        allocation of LuaAlloc-internal data (usually long-lived. alloc'd, realloc'd to enlarge, but never shrunk. free'd only in luaalloc_delete())
+        allocation of LuaAlloc-internal data (usually long-lived. alloc'd, never shrunk. free'd when replaced by a larger one, or in luaalloc_delete())
     case 0: default:
         some other allocation (not used by LuaAlloc. Maybe some other code uses this allocator as well?)
 }
@@ -0,0 +1,151 @@
+/*
+ * BinMap.cpp
+ *
+ * Zero-copy loader for the .jpsb format written by mapconv.
+ */
+
+#include "BinMap.h"
+#include <string.h>
+
+#ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+BinMap::BinMap()
+	: base(NULL), size(0), hdr(NULL), grid(NULL), tables(NULL), scen(NULL)
+#ifdef _WIN32
+	, hfile(INVALID_HANDLE_VALUE), hmapping(NULL)
+#endif
+{
+}
+
+BinMap::~BinMap()
+{
+	unload();
+}
+
+static bool inRange(size_t size, binmap_u32 offs, size_t len)
+{
+	return offs <= size && len <= size - offs;
+}
+
+bool BinMap::load(const char *fn)
+{
+	unload();
+
+#ifdef _WIN32
+	HANDLE f = CreateFileA(fn, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(f == INVALID_HANDLE_VALUE)
+		return false;
+	hfile = f;
+	LARGE_INTEGER sz;
+	if(!GetFileSizeEx(f, &sz) || !sz.QuadPart)
+	{
+		unload();
+		return false;
+	}
+	HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!m)
+	{
+		unload();
+		return false;
+	}
+	hmapping = m;
+	base = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if(!base)
+	{
+		unload();
+		return false;
+	}
+	size = (size_t)sz.QuadPart;
+#else
+	int fd = open(fn, O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) || !st.st_size)
+	{
+		close(fd);
+		return false;
+	}
+	void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // the mapping keeps the file referenced
+	if(p == MAP_FAILED)
+		return false;
+	base = p;
+	size = (size_t)st.st_size;
+#endif
+
+	const BinMapHeader *h = (const BinMapHeader*)base;
+	if(size < sizeof(BinMapHeader)
+		|| memcmp(h->magic, "JPSM", 4)
+		|| h->version != BINMAP_VERSION
+		|| h->fileSize != size
+		|| h->width > 0xffff || h->height > 0xffff // same limit as mapconv; keeps the arithmetic below from overflowing
+		|| h->rowWords < (h->width + 31) / 32
+		|| !inRange(size, h->nameOffset, 1)
+		|| !inRange(size, h->gridOffset, (size_t)h->rowWords * h->height * sizeof(binmap_u32))
+		|| !inRange(size, h->tablesOffset, (size_t)h->numTables * sizeof(BinMapTable))
+		|| !inRange(size, h->scenOffset, (size_t)h->numScenarios * sizeof(BinScenario))
+		|| !memchr((const char*)base + h->nameOffset, 0, size - h->nameOffset))
+	{
+		unload();
+		return false;
+	}
+
+	const BinMapTable *t = (const BinMapTable*)((const char*)base + h->tablesOffset);
+	for(unsigned i = 0; i < h->numTables; ++i)
+		if(!inRange(size, t[i].offset, t[i].size)
+			|| (t[i].type == BINMAP_TABLE_CLEARANCE && t[i].size != h->width * h->height))
+		{
+			unload();
+			return false;
+		}
+
+	hdr = h;
+	grid = (const binmap_u32*)((const char*)base + h->gridOffset);
+	tables = t;
+	scen = (const BinScenario*)((const char*)base + h->scenOffset);
+	return true;
+}
+
+void BinMap::unload()
+{
+#ifdef _WIN32
+	if(base)
+		UnmapViewOfFile(base);
+	if(hmapping)
+		CloseHandle((HANDLE)hmapping);
+	if(hfile != INVALID_HANDLE_VALUE)
+		CloseHandle((HANDLE)hfile);
+	hmapping = NULL;
+	hfile = INVALID_HANDLE_VALUE;
+#else
+	if(base)
+		munmap((void*)base, size);
+#endif
+	base = NULL;
+	size = 0;
+	hdr = NULL;
+	grid = NULL;
+	tables = NULL;
+	scen = NULL;
+}
+
+const void *BinMap::getTable(unsigned type, unsigned *psize) const
+{
+	for(unsigned i = 0; i < hdr->numTables; ++i)
+		if(tables[i].type == type)
+		{
+			if(psize)
+				*psize = tables[i].size;
+			return (const char*)base + tables[i].offset;
+		}
+	return NULL;
+}
@@ -0,0 +1,111 @@
+/*
+ * BinMap.h
+ *
+ * Compact binary container for movingai maps + scenarios.
+ * Written by mapconv, loaded zero-copy via mmap() so that many maps
+ * can be brought up quickly and the pages are shared between processes.
+ *
+ * File layout (all offsets in bytes from file start, all sections 8-aligned,
+ * little endian as written by the host):
+ *   BinMapHeader
+ *   map name (NUL-terminated; the path of the original .map file)
+ *   grid: height rows of rowWords u32 each; bit (x & 31) of word (x >> 5) set = walkable
+ *   table directory: numTables x BinMapTable
+ *   table payloads (optional precomputed data, see BinMapTableType)
+ *   scenarios: numScenarios x BinScenario
+ */
+
+#ifndef BINMAP_H
+#define BINMAP_H
+
+#include <stddef.h>
+
+typedef unsigned int binmap_u32;
+typedef unsigned short binmap_u16;
+
+enum { BINMAP_VERSION = 1 };
+
+struct BinMapHeader
+{
+	char magic[4]; // "JPSM"
+	binmap_u32 version;
+	binmap_u32 width, height;
+	binmap_u32 rowWords; // u32 words per grid row
+	binmap_u32 numTables;
+	binmap_u32 numScenarios;
+	binmap_u32 nameOffset;
+	binmap_u32 gridOffset;
+	binmap_u32 tablesOffset;
+	binmap_u32 scenOffset;
+	binmap_u32 fileSize;
+};
+
+enum BinMapTableType
+{
+	BINMAP_TABLE_NONE = 0,
+	// width * height bytes, row by row: side length of the largest free square
+	// whose top-left corner is at that cell (capped at 255). Same as JPS::ClearanceMap.
+	BINMAP_TABLE_CLEARANCE = 1
+};
+
+struct BinMapTable
+{
+	binmap_u32 type; // BinMapTableType
+	binmap_u32 offset;
+	binmap_u32 size;
+	binmap_u32 reserved;
+};
+
+struct BinScenario
+{
+	binmap_u16 startx, starty, goalx, goaly;
+	binmap_u32 bucket;
+	float distance;
+};
+
+/** A loaded .jpsb file. All pointers point directly into the mapped file. */
+class BinMap
+{
+public:
+	BinMap();
+	~BinMap();
+
+	// Maps the file read-only. Returns false if the file can't be opened or is malformed
+	// (sections out of bounds, width or height above 0xffff, tables of the wrong size).
+	bool load(const char *fn);
+	void unload();
+
+	inline bool isLoaded() const { return !!hdr; }
+	inline unsigned getWidth() const { return hdr->width; }
+	inline unsigned getHeight() const { return hdr->height; }
+	inline unsigned getRowWords() const { return hdr->rowWords; }
+	inline const binmap_u32 *getGrid() const { return grid; }
+	inline const char *getMapName() const { return (const char*)base + hdr->nameOffset; }
+	inline unsigned getNumScenarios() const { return hdr->numScenarios; }
+	inline const BinScenario& getScenario(unsigned i) const { return scen[i]; }
+
+	// Returns the payload of the first table of the given type, or NULL if there is none.
+	const void *getTable(unsigned type, unsigned *psize = NULL) const;
+
+	inline bool operator()(unsigned x, unsigned y) const
+	{
+		return x < hdr->width && y < hdr->height
+			&& ((grid[y * hdr->rowWords + (x >> 5)] >> (x & 31)) & 1);
+	}
+
+private:
+	const void *base;
+	size_t size;
+	const BinMapHeader *hdr;
+	const binmap_u32 *grid;
+	const BinMapTable *tables;
+	const BinScenario *scen;
+#ifdef _WIN32
+	void *hfile, *hmapping;
+#endif
+
+	BinMap(const BinMap&);
+	BinMap& operator=(const BinMap&);
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * JPSTrace.cpp
+ *
+ * Trace file I/O and the timer used by TracedSearcher.
+ */
+
+#include "JPSTrace.h"
+#include <string.h>
+
+#ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
+unsigned long long traceNanos()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq;
+	if(!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER c;
+	QueryPerformanceCounter(&c);
+	return (unsigned long long)(c.QuadPart / freq.QuadPart) * 1000000000ull
+		+ (unsigned long long)(c.QuadPart % freq.QuadPart) * 1000000000ull / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+bool TraceWriter::open(const char *fn)
+{
+	close();
+	f = fopen(fn, "wb");
+	if(!f)
+		return false;
+	TraceHeader hdr;
+	memcpy(hdr.magic, "JPST", 4);
+	hdr.version = TRACE_VERSION;
+	if(fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void TraceWriter::close()
+{
+	if(f)
+		fclose(f);
+	f = NULL;
+}
+
+void TraceWriter::write(const TraceRecord& r)
+{
+	if(f)
+		fwrite(&r, sizeof(r), 1, f);
+}
+
+void TraceWriter::grid(unsigned w, unsigned h, unsigned checksum)
+{
+	TraceRecord r;
+	memset(&r, 0, sizeof(r));
+	r.type = TRACE_GRID;
+	r.args[0] = w;
+	r.args[1] = h;
+	r.args[2] = checksum;
+	write(r);
+}
+
+bool TraceReader::open(const char *fn)
+{
+	close();
+	f = fopen(fn, "rb");
+	if(!f)
+		return false;
+	TraceHeader hdr;
+	if(fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, "JPST", 4) || hdr.version != TRACE_VERSION)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void TraceReader::close()
+{
+	if(f)
+		fclose(f);
+	f = NULL;
+}
+
+bool TraceReader::read(TraceRecord& r)
+{
+	return f && fread(&r, sizeof(r), 1, f) == 1;
+}
@@ -0,0 +1,218 @@
+/*
+ * JPSTrace.h
+ *
+ * Opt-in recording of pathfinding queries, for replaying a real workload offline
+ * (see jpsreplay.cpp). Wrap the searcher in a TracedSearcher and hand it a
+ * TraceWriter; every findPathInit/findPathStep/findPathFinish call then ends up
+ * in the trace with its arguments, result and the time it took.
+ * Without a writer TracedSearcher behaves exactly like JPS::Searcher.
+ *
+ * File layout (host byte order):
+ *   TraceHeader
+ *   TraceRecord, ... until end of file
+ * A TRACE_GRID record (size + checksum of the walkable cells) precedes the queries
+ * made on that grid, so the replay tool can pick the matching map and refuse to
+ * replay against a different one.
+ */
+
+#ifndef JPSTRACE_H
+#define JPSTRACE_H
+
+#include "jps.hh"
+#include <stdio.h>
+#include <math.h>
+
+typedef unsigned int trace_u32;
+
+enum { TRACE_VERSION = 1 };
+
+struct TraceHeader
+{
+	char magic[4]; // "JPST"
+	trace_u32 version;
+};
+
+enum TraceRecordType
+{
+	TRACE_GRID = 1,   // args: width, height, checksum
+	TRACE_INIT = 2,   // args: start x, start y, end x, end y; flags
+	TRACE_STEP = 3,   // args[0]: limit (as int); count: steps done so far
+	TRACE_FINISH = 4  // args[0]: step; count: positions added; cost: length of the added path
+};
+
+struct TraceRecord
+{
+	trace_u32 type; // TraceRecordType
+	trace_u32 args[4];
+	trace_u32 flags;
+	trace_u32 result; // JPS_Result
+	trace_u32 nanos;  // time spent in the call
+	trace_u32 count;
+	float cost;
+};
+
+// Monotonic clock, in nanoseconds
+unsigned long long traceNanos();
+
+class TraceWriter
+{
+public:
+	TraceWriter() : f(NULL) {}
+	~TraceWriter() { close(); }
+
+	bool open(const char *fn);
+	void close();
+	inline bool isOpen() const { return !!f; }
+	void write(const TraceRecord& r);
+
+	// Call whenever the searched grid is replaced or modified
+	void grid(unsigned w, unsigned h, unsigned checksum);
+
+private:
+	FILE *f;
+	TraceWriter(const TraceWriter&);
+	TraceWriter& operator=(const TraceWriter&);
+};
+
+class TraceReader
+{
+public:
+	TraceReader() : f(NULL) {}
+	~TraceReader() { close(); }
+
+	bool open(const char *fn); // fails if the header doesn't match
+	void close();
+	bool read(TraceRecord& r); // false at end of file
+
+private:
+	FILE *f;
+	TraceReader(const TraceReader&);
+	TraceReader& operator=(const TraceReader&);
+};
+
+// FNV-1a over the walkable bits of a w x h grid, 32 cells per word
+template<typename GRID>
+unsigned gridChecksum(const GRID& grid, unsigned w, unsigned h)
+{
+	unsigned hash = 2166136261u;
+	for(unsigned y = 0; y < h; ++y)
+		for(unsigned x = 0; x < w; x += 32)
+		{
+			unsigned word = 0;
+			for(unsigned i = 0; i < 32 && x + i < w; ++i)
+				if(grid(x + i, y))
+					word |= 1u << i;
+			for(unsigned i = 0; i < 4; ++i)
+			{
+				hash ^= (word >> (i * 8)) & 0xff;
+				hash *= 16777619u;
+			}
+		}
+	return hash;
+}
+
+// Euclidean length of path[from..], starting at start
+template<typename PV>
+double tracePathCost(JPS::Position start, const PV& path, size_t from)
+{
+	double accu = 0;
+	JPS::Position last = start;
+	for(size_t i = from; i < path.size(); ++i)
+	{
+		const int dx = int(path[i].x - last.x), dy = int(path[i].y - last.y);
+		accu += sqrt(double(dx*dx + dy*dy));
+		last = path[i];
+	}
+	return accu;
+}
+
+template<typename GRID>
+class TracedSearcher : public JPS::Searcher<GRID>
+{
+	typedef JPS::Searcher<GRID> Base;
+public:
+	TracedSearcher(const GRID& g, TraceWriter *w = NULL, void *user = 0)
+		: Base(g, user), writer(w), start(JPS::npos) {}
+
+	void setWriter(TraceWriter *w) { writer = w; }
+
+	template<typename PV>
+	bool findPath(PV& path, JPS::Position s, JPS::Position e, unsigned step, JPS_Flags flags = JPS_Flag_Default)
+	{
+		JPS_Result res = findPathInit(s, e, flags);
+		if(res == JPS_EMPTY_PATH)
+			return true;
+		while(res == JPS_NEED_MORE_STEPS)
+			res = findPathStep(0);
+		return res == JPS_FOUND_PATH && findPathFinish(path, step) == JPS_FOUND_PATH;
+	}
+
+	JPS_Result findPathInit(JPS::Position s, JPS::Position e, JPS_Flags flags = JPS_Flag_Default)
+	{
+		if(!writer)
+			return Base::findPathInit(s, e, flags);
+		start = s;
+		const unsigned long long t = traceNanos();
+		const JPS_Result res = Base::findPathInit(s, e, flags);
+		TraceRecord r = record(TRACE_INIT, res, t);
+		r.args[0] = s.x;
+		r.args[1] = s.y;
+		r.args[2] = e.x;
+		r.args[3] = e.y;
+		r.flags = flags;
+		writer->write(r);
+		return res;
+	}
+
+	JPS_Result findPathStep(int limit)
+	{
+		if(!writer)
+			return Base::findPathStep(limit);
+		const unsigned long long t = traceNanos();
+		const JPS_Result res = Base::findPathStep(limit);
+		TraceRecord r = record(TRACE_STEP, res, t);
+		r.args[0] = (trace_u32)limit;
+		r.count = this->getStepsDone();
+		writer->write(r);
+		return res;
+	}
+
+	template<typename PV>
+	JPS_Result findPathFinish(PV& path, unsigned step) const
+	{
+		if(!writer)
+			return Base::findPathFinish(path, step);
+		const size_t offset = path.size();
+		const unsigned long long t = traceNanos();
+		const JPS_Result res = Base::findPathFinish(path, step);
+		TraceRecord r = record(TRACE_FINISH, res, t);
+		r.args[0] = step;
+		if(res == JPS_FOUND_PATH)
+		{
+			r.count = (trace_u32)(path.size() - offset);
+			r.cost = (float)tracePathCost(start, path, offset);
+		}
+		writer->write(r);
+		return res;
+	}
+
+private:
+	static TraceRecord record(unsigned type, JPS_Result res, unsigned long long t0)
+	{
+		const unsigned long long dt = traceNanos() - t0;
+		TraceRecord r;
+		r.type = type;
+		r.args[0] = r.args[1] = r.args[2] = r.args[3] = 0;
+		r.flags = 0;
+		r.result = res;
+		r.nanos = dt > 0xffffffffull ? 0xffffffffu : (trace_u32)dt;
+		r.count = 0;
+		r.cost = 0;
+		return r;
+	}
+
+	TraceWriter *writer;
+	JPS::Position start;
+};
+
+#endif
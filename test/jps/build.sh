@@ -1,3 +1,7 @@
 #!/bin/sh
 c++ testjps1.cpp -I../../ -DNDEBUG -o testjps1 -O3 -pipe -Wall -pedantic
-c++ testjps2.cpp -I../../ ScenarioLoader.cpp -DNDEBUG -o testjps2 -O3 -pipe -Wall -pedantic
+c++ testjps2.cpp -I../../ ScenarioLoader.cpp BinMap.cpp JPSTrace.cpp -DNDEBUG -o testjps2 -O3 -pipe -Wall -pedantic
+c++ testjps3d.cpp -I../../ -DNDEBUG -o testjps3d -O3 -pipe -Wall -pedantic
+c++ testjpsweighted.cpp -I../../ -DNDEBUG -o testjpsweighted -O3 -pipe -Wall -pedantic
+c++ mapconv.cpp -I../../ ScenarioLoader.cpp -DNDEBUG -o mapconv -O3 -pipe -Wall -pedantic
+c++ jpsreplay.cpp -I../../ BinMap.cpp JPSTrace.cpp -DNDEBUG -o jpsreplay -O3 -pipe -Wall -pedantic
@@ -0,0 +1,237 @@
+// Replays a query trace recorded with TracedSearcher (see JPSTrace.h) and compares
+// timing and path cost against the recording.
+// How to use:
+//  ./testjps2 -record run.jpst maps/*.scen
+//  ./mapconv maps/*.scen
+//  ./jpsreplay [options] run.jpst maps/*.jpsb
+// Maps are matched to the trace by grid checksum, so every map used in the trace must be given.
+// Options:
+//  -set FLAGS    OR these JPS_Flags into every query (e.g. -set 2 replays with plain A*)
+//  -clear FLAGS  remove these JPS_Flags from every query
+//  -limit N      override the step limit of every findPathStep() call
+//  -v            print every query, not only the ones whose result differs
+
+#include "JPSTrace.h"
+#include "BinMap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static void die(const char *msg)
+{
+	fprintf(stderr, "%s\n", msg);
+	exit(1);
+}
+
+struct Options
+{
+	Options() : setFlags(0), clearFlags(0), limit(-1), verbose(false) {}
+	JPS_Flags setFlags, clearFlags;
+	int limit; // < 0: as recorded
+	bool verbose;
+};
+
+struct QueryStats
+{
+	void reset() { recNanos = repNanos = 0; recCost = repCost = 0; recFound = repFound = finished = false; }
+	double recNanos, repNanos;
+	double recCost, repCost;
+	bool recFound, repFound;
+	bool finished; // the recording called findPathFinish()
+};
+
+struct Totals
+{
+	Totals() : queries(0), costDiffs(0), foundDiffs(0), recNanos(0), repNanos(0) {}
+	unsigned queries, costDiffs, foundDiffs;
+	double recNanos, repNanos;
+};
+
+class Replayer
+{
+public:
+	Replayer(const Options& opt) : opt(opt), map(NULL), search(NULL), state(JPS_NO_PATH), active(false) {}
+	~Replayer()
+	{
+		delete search;
+		for(size_t i = 0; i < maps.size(); ++i)
+			delete maps[i];
+	}
+
+	void addMap(const char *fn)
+	{
+		BinMap *m = new BinMap;
+		if(!m->load(fn))
+			die(fn);
+		maps.push_back(m);
+		sums.push_back(gridChecksum(*m, m->getWidth(), m->getHeight()));
+	}
+
+	void run(TraceReader& in)
+	{
+		TraceRecord r;
+		while(in.read(r))
+		{
+			switch(r.type)
+			{
+				case TRACE_GRID: endQuery(); selectGrid(r); break;
+				case TRACE_INIT: endQuery(); init(r); break;
+				case TRACE_STEP: step(r); break;
+				case TRACE_FINISH: finish(r); break;
+				default: die("Unknown trace record");
+			}
+		}
+		endQuery();
+		printf("Queries: %u\n", tot.queries);
+		printf("Recorded time: %.3f ms, replayed: %.3f ms (x%.3f)\n",
+			tot.recNanos / 1e6, tot.repNanos / 1e6, tot.recNanos ? tot.repNanos / tot.recNanos : 0.0);
+		printf("Found/not found differences: %u, path cost differences: %u\n", tot.foundDiffs, tot.costDiffs);
+	}
+
+private:
+	void selectGrid(const TraceRecord& r)
+	{
+		delete search;
+		search = NULL;
+		map = NULL;
+		for(size_t i = 0; i < maps.size(); ++i)
+			if(sums[i] == r.args[2] && maps[i]->getWidth() == r.args[0] && maps[i]->getHeight() == r.args[1])
+				map = maps[i];
+		if(!map)
+		{
+			fprintf(stderr, "No map given for grid %ux%u, checksum %08x\n", r.args[0], r.args[1], r.args[2]);
+			exit(1);
+		}
+		search = new JPS::Searcher<BinMap>(*map);
+	}
+
+	void init(const TraceRecord& r)
+	{
+		if(!search)
+			die("Query before grid record");
+		q.reset();
+		cur = r;
+		active = true;
+		start = JPS::Pos(r.args[0], r.args[1]);
+		q.recNanos += r.nanos;
+		const JPS_Flags flags = (r.flags | opt.setFlags) & ~opt.clearFlags;
+		const unsigned long long t = traceNanos();
+		state = search->findPathInit(start, JPS::Pos(r.args[2], r.args[3]), flags);
+		q.repNanos += double(traceNanos() - t);
+		q.recFound = r.result == JPS_FOUND_PATH || r.result == JPS_EMPTY_PATH;
+	}
+
+	void step(const TraceRecord& r)
+	{
+		if(!active)
+			return;
+		q.recNanos += r.nanos;
+		q.recFound = r.result == JPS_FOUND_PATH;
+		if(state == JPS_NEED_MORE_STEPS)
+			doStep(opt.limit >= 0 ? opt.limit : (int)r.args[0]);
+	}
+
+	void finish(const TraceRecord& r)
+	{
+		if(!active)
+			return;
+		q.recNanos += r.nanos;
+		q.recFound = r.result == JPS_FOUND_PATH;
+		q.recCost = r.cost;
+		q.finished = true;
+		completeSearch();
+		if(state == JPS_FOUND_PATH)
+		{
+			path.clear();
+			const unsigned long long t = traceNanos();
+			const JPS_Result res = search->findPathFinish(path, r.args[0]);
+			q.repNanos += double(traceNanos() - t);
+			q.repFound = res == JPS_FOUND_PATH;
+			q.repCost = tracePathCost(start, path, 0);
+		}
+	}
+
+	void doStep(int limit)
+	{
+		const unsigned long long t = traceNanos();
+		state = search->findPathStep(limit);
+		q.repNanos += double(traceNanos() - t);
+	}
+
+	// The replayed configuration may need more steps than the recorded one did
+	void completeSearch()
+	{
+		while(state == JPS_NEED_MORE_STEPS)
+			doStep(0);
+	}
+
+	void endQuery()
+	{
+		if(!active)
+			return;
+		active = false;
+		completeSearch();
+		if(!q.finished)
+			q.repFound = state == JPS_FOUND_PATH || state == JPS_EMPTY_PATH;
+		const bool foundDiff = q.recFound != q.repFound;
+		const bool costDiff = q.finished && q.recFound && q.repFound && fabs(q.recCost - q.repCost) > 0.01;
+		++tot.queries;
+		tot.foundDiffs += foundDiff;
+		tot.costDiffs += costDiff;
+		tot.recNanos += q.recNanos;
+		tot.repNanos += q.repNanos;
+		if(opt.verbose || foundDiff || costDiff)
+			printf("%s #%u (%u, %u) -> (%u, %u): time %.1f -> %.1f us, found %d -> %d, cost %.3f -> %.3f\n",
+				(foundDiff || costDiff) ? "##" : "  ", tot.queries - 1,
+				cur.args[0], cur.args[1], cur.args[2], cur.args[3],
+				q.recNanos / 1e3, q.repNanos / 1e3, q.recFound, q.repFound, q.recCost, q.repCost);
+	}
+
+	const Options& opt;
+	std::vector<BinMap*> maps;
+	std::vector<unsigned> sums;
+	BinMap *map;
+	JPS::Searcher<BinMap> *search;
+	JPS_Result state;
+	bool active;
+	TraceRecord cur;
+	JPS::Position start;
+	JPS::PathVector path;
+	QueryStats q;
+	Totals tot;
+};
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	int i = 1;
+	for(; i < argc && argv[i][0] == '-'; ++i)
+	{
+		if(!strcmp(argv[i], "-v"))
+			opt.verbose = true;
+		else if(i + 1 < argc && !strcmp(argv[i], "-set"))
+			opt.setFlags = strtoul(argv[++i], NULL, 0);
+		else if(i + 1 < argc && !strcmp(argv[i], "-clear"))
+			opt.clearFlags = strtoul(argv[++i], NULL, 0);
+		else if(i + 1 < argc && !strcmp(argv[i], "-limit"))
+			opt.limit = atoi(argv[++i]);
+		else
+			die("Unknown option");
+	}
+	if(argc - i < 2)
+	{
+		fprintf(stderr, "Usage: %s [-set FLAGS] [-clear FLAGS] [-limit N] [-v] trace.jpst map.jpsb ...\n", argv[0]);
+		return 2;
+	}
+
+	TraceReader in;
+	if(!in.open(argv[i]))
+		die(argv[i]);
+	Replayer rep(opt);
+	for(int k = i + 1; k < argc; ++k)
+		rep.addMap(argv[k]);
+	rep.run(in);
+	return 0;
+}
@@ -0,0 +1,214 @@
+// Converts movingai .map / .map.scen files into the binary .jpsb format (see BinMap.h).
+// How to use:
+//  ./mapconv maps/*.scen
+// writes maps/<name>.map.jpsb next to each input file (".scen" is replaced, anything else gets ".jpsb" appended).
+// A .scen input embeds its scenarios and the map it references; a plain .map input embeds the map only.
+// A clearance table (BINMAP_TABLE_CLEARANCE) is always included.
+
+#include "BinMap.h"
+#include "ScenarioLoader.h"
+#include "jps.hh"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Same walkability rule as MapGrid in testjps2.cpp
+static bool walkable(char c)
+{
+	return c == '.' || c == 'G' || c == 'S';
+}
+
+struct TextMap
+{
+	unsigned w, h;
+	std::vector<std::string> lines;
+};
+
+static bool loadTextMap(TextMap& m, const char *fn)
+{
+	FILE *f = fopen(fn, "rb");
+	if(!f)
+		return false;
+	char buf[64];
+	m.w = m.h = 0;
+	// header: "type octile", "height N", "width N", "map"
+	while(fscanf(f, "%63s", buf) == 1)
+	{
+		if(!strcmp(buf, "height"))
+		{
+			if(fscanf(f, "%u", &m.h) != 1)
+				break;
+		}
+		else if(!strcmp(buf, "width"))
+		{
+			if(fscanf(f, "%u", &m.w) != 1)
+				break;
+		}
+		else if(!strcmp(buf, "map"))
+			break;
+	}
+	m.lines.clear();
+	if(m.w && m.h)
+	{
+		std::vector<char> line(m.w + 2);
+		int c;
+		while(m.lines.size() < m.h && (c = fgetc(f)) != EOF)
+		{
+			if(c == '\n' || c == '\r')
+				continue;
+			line[0] = (char)c;
+			if(fread(&line[1], 1, m.w - 1, f) != m.w - 1)
+				break;
+			m.lines.push_back(std::string(&line[0], m.w));
+		}
+	}
+	fclose(f);
+	return m.w && m.h && m.lines.size() == m.h;
+}
+
+struct BitGrid
+{
+	BitGrid(const std::vector<binmap_u32>& bits, unsigned w, unsigned h, unsigned rowWords)
+		: bits(bits), w(w), h(h), rowWords(rowWords) {}
+	bool operator()(unsigned x, unsigned y) const
+	{
+		return x < w && y < h && ((bits[y * rowWords + (x >> 5)] >> (x & 31)) & 1);
+	}
+	const std::vector<binmap_u32>& bits;
+	unsigned w, h, rowWords;
+};
+
+static void pad8(std::vector<char>& out)
+{
+	while(out.size() & 7)
+		out.push_back(0);
+}
+
+template<typename T> static binmap_u32 append(std::vector<char>& out, const T *p, size_t n)
+{
+	pad8(out);
+	const binmap_u32 offs = (binmap_u32)out.size();
+	if(n)
+		out.insert(out.end(), (const char*)p, (const char*)(p + n));
+	return offs;
+}
+
+static bool convert(const char *infile)
+{
+	std::string in = infile;
+	const size_t inlen = in.length();
+	const bool isScen = inlen > 5 && in.compare(inlen - 5, 5, ".scen") == 0;
+	const std::string out = (isScen ? in.substr(0, inlen - 5) : in) + ".jpsb";
+
+	std::vector<BinScenario> scen;
+	std::string mapname = in;
+	if(isScen)
+	{
+		ScenarioLoader loader(infile);
+		if(!loader.GetNumExperiments())
+		{
+			fprintf(stderr, "[%s] no scenarios\n", infile);
+			return false;
+		}
+		mapname = loader.GetNthExperiment(0).GetMapName();
+		for(unsigned i = 0; i < loader.GetNumExperiments(); ++i)
+		{
+			const Experiment& ex = loader.GetNthExperiment(i);
+			if(strcmp(ex.GetMapName(), mapname.c_str()))
+			{
+				fprintf(stderr, "[%s] scenario %u refers to a different map, skipped\n", infile, i);
+				continue;
+			}
+			BinScenario s;
+			s.startx = (binmap_u16)ex.GetStartX();
+			s.starty = (binmap_u16)ex.GetStartY();
+			s.goalx = (binmap_u16)ex.GetGoalX();
+			s.goaly = (binmap_u16)ex.GetGoalY();
+			s.bucket = (binmap_u32)ex.GetBucket();
+			s.distance = (float)ex.GetDistance();
+			scen.push_back(s);
+		}
+	}
+
+	TextMap m;
+	if(!loadTextMap(m, mapname.c_str()))
+	{
+		fprintf(stderr, "[%s] failed to load map [%s]\n", infile, mapname.c_str());
+		return false;
+	}
+	if(m.w > 0xffff || m.h > 0xffff)
+	{
+		fprintf(stderr, "[%s] map too large\n", infile);
+		return false;
+	}
+
+	BinMapHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, "JPSM", 4);
+	hdr.version = BINMAP_VERSION;
+	hdr.width = m.w;
+	hdr.height = m.h;
+	hdr.rowWords = (m.w + 31) / 32;
+	hdr.numScenarios = (binmap_u32)scen.size();
+
+	std::vector<binmap_u32> bits((size_t)hdr.rowWords * m.h, 0);
+	for(unsigned y = 0; y < m.h; ++y)
+		for(unsigned x = 0; x < m.w; ++x)
+			if(walkable(m.lines[y][x]))
+				bits[(size_t)y * hdr.rowWords + (x >> 5)] |= 1u << (x & 31);
+
+	JPS::ClearanceMap clearance;
+	if(!clearance.build(BitGrid(bits, m.w, m.h, hdr.rowWords), m.w, m.h))
+	{
+		fprintf(stderr, "[%s] out of memory\n", infile);
+		return false;
+	}
+
+	std::vector<BinMapTable> tables;
+
+	std::vector<char> buf;
+	append(buf, &hdr, 1);
+	hdr.nameOffset = append(buf, mapname.c_str(), mapname.length() + 1);
+	hdr.gridOffset = append(buf, &bits[0], bits.size());
+
+	BinMapTable t;
+	memset(&t, 0, sizeof(t));
+	t.type = BINMAP_TABLE_CLEARANCE;
+	t.size = m.w * m.h;
+	t.offset = append(buf, clearance.getData(), t.size);
+	tables.push_back(t);
+
+	hdr.numTables = (binmap_u32)tables.size();
+	hdr.tablesOffset = append(buf, tables.empty() ? NULL : &tables[0], tables.size());
+	hdr.scenOffset = append(buf, scen.empty() ? NULL : &scen[0], scen.size());
+	pad8(buf);
+	hdr.fileSize = (binmap_u32)buf.size();
+	memcpy(&buf[0], &hdr, sizeof(hdr));
+
+	FILE *f = fopen(out.c_str(), "wb");
+	if(!f)
+	{
+		fprintf(stderr, "[%s] can't write [%s]\n", infile, out.c_str());
+		return false;
+	}
+	const bool ok = fwrite(&buf[0], 1, buf.size(), f) == buf.size();
+	fclose(f);
+	printf("[%s] -> [%s] %ux%u, %u scenarios, %u bytes\n",
+		infile, out.c_str(), m.w, m.h, hdr.numScenarios, hdr.fileSize);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage: %s file.map[.scen] ...\n", argv[0]);
+		return 2;
+	}
+	int fails = 0;
+	for(int i = 1; i < argc; ++i)
+		fails += !convert(argv[i]);
+	return fails ? 1 : 0;
+}
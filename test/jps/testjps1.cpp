@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <string>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <vector>
 
@@ -57,6 +58,18 @@ struct MyGrid
 	mutable std::vector<std::string> out;
 };
 
+// Wraps the built-in jump to count the calls, which shows the searcher goes through the policy hook
+struct CountingPolicy : public JPS::DefaultPolicy
+{
+    static unsigned jumps;
+    template<typename S>
+    static inline JPS::Position Jump(S& s, const JPS::Position& p, const JPS::Position& src)
+    {
+        ++jumps;
+        return s._jump(p, src);
+    }
+};
+unsigned CountingPolicy::jumps = 0;
 
 int main(int argc, char **argv)
 {
@@ -107,5 +120,189 @@ int main(int argc, char **argv)
 	std::cout << "Search steps:   " << totalsteps << std::endl;
     std::cout << "Nodes expanded: " << totalnodes << std::endl;
     std::cout << "Memory used: " << search.getTotalMemoryInUse() << " bytes" << std::endl;
+
+    JPS::Searcher<MyGrid, CountingPolicy> counted(grid);
+    JPS::PathVector pathc;
+	for(size_t i = 1; i < waypoints.size(); ++i)
+        if(!counted.findPath(pathc, waypoints[i-1], waypoints[i], step))
+        {
+			std::cout << "Path not found with policy hooks!" << std::endl;
+			return 1;
+		}
+    if(pathc.size() != path.size() || !std::equal(pathc.begin(), pathc.end(), path.begin()) || !CountingPolicy::jumps)
+    {
+        std::cout << "Policy hooks changed the path!" << std::endl;
+        return 1;
+    }
+    std::cout << "Jumps through policy hook: " << CountingPolicy::jumps << std::endl;
+
+    // Same waypoints again, without diagonal moves.
+    // The configuration is fixed at compile time, so no flags are passed.
+    JPS::Searcher<MyGrid, JPS::FixedPolicy<JPS_Flag_FourConnected> > search4(grid);
+    JPS::PathVector path4;
+    JPS::Position last = waypoints.empty() ? JPS::npos : waypoints[0];
+	for(size_t i = 1; i < waypoints.size(); ++i)
+	{
+        if(!search4.findPath(path4, waypoints[i-1], waypoints[i], 1))
+        {
+			std::cout << "4-connected path not found!" << std::endl;
+			return 1;
+		}
+	}
+    for(JPS::PathVector::iterator it = path4.begin(); it != path4.end(); ++it)
+    {
+        const unsigned d = (unsigned)abs(int(it->x - last.x)) + (unsigned)abs(int(it->y - last.y));
+        if(d != 1 || !grid(it->x, it->y))
+        {
+            std::cout << "Invalid 4-connected step!" << std::endl;
+            return 1;
+        }
+        last = *it;
+    }
+    std::cout << "4-connected path length: " << path4.size() << std::endl;
+
+    // A searcher moved into a container or swapped keeps its memory,
+    // and rebind() points it at another map without reallocating.
+    MyGrid grid2(data);
+#if JPS_HAS_MOVE
+    std::vector<JPS::Searcher<MyGrid> > pool;
+    pool.push_back(JPS::Searcher<MyGrid>(grid2));
+    pool.push_back(static_cast<JPS::Searcher<MyGrid>&&>(search));
+    JPS::Searcher<MyGrid>& reused = pool.back();
+#else
+    JPS::Searcher<MyGrid> reused(grid2);
+    reused.swap(search);
+#endif
+    const unsigned mem = (unsigned)reused.getTotalMemoryInUse();
+    if(!mem || &reused.getGrid() != &grid)
+    {
+        std::cout << "Moved searcher lost its grid or memory!" << std::endl;
+        return 1;
+    }
+    reused.rebind(grid2);
+    JPS::PathVector path2;
+	for(size_t i = 1; i < waypoints.size(); ++i)
+        if(!reused.findPath(path2, waypoints[i-1], waypoints[i], step))
+        {
+			std::cout << "Path not found after rebind!" << std::endl;
+			return 1;
+		}
+    if(path2.size() != path.size() || !std::equal(path2.begin(), path2.end(), path.begin()))
+    {
+        std::cout << "Different path after rebind!" << std::endl;
+        return 1;
+    }
+    if(reused.getTotalMemoryInUse() != mem)
+    {
+        std::cout << "Rebound searcher reallocated!" << std::endl;
+        return 1;
+    }
+    std::cout << "Rebound searcher: same path, " << mem << " bytes kept" << std::endl;
+
+    // A search that needs more than the memory limit stops before going over it,
+    // and with auto-shrink the memory of one big search is given back after some small ones.
+    JPS::Searcher<MyGrid> budget(grid);
+    const unsigned limit = 4096;
+    budget.setMemoryLimit(limit);
+    JPS_Result res = budget.findPathInit(waypoints[0], waypoints[1], JPS_Flag_AStarOnly | JPS_Flag_NoGreedy);
+    while(res == JPS_NEED_MORE_STEPS)
+        res = budget.findPathStep(0);
+    const unsigned stopped = (unsigned)budget.getTotalMemoryInUse();
+    if(res != JPS_BUDGET_EXCEEDED || stopped > limit)
+    {
+        std::cout << "Memory limit not kept: " << stopped << " bytes" << std::endl;
+        return 1;
+    }
+    budget.setMemoryLimit(0);
+    budget.setAutoShrink(true);
+    JPS::PathVector tmp;
+    if(!budget.findPath(tmp, waypoints[0], waypoints[1], 0, JPS_Flag_AStarOnly))
+        return 1;
+    const unsigned peak = (unsigned)budget.getTotalMemoryInUse();
+    const JPS::Position next = JPS::Pos(waypoints[0].x - 1, waypoints[0].y);
+    for(unsigned i = 0; i < 20; ++i)
+        if(!budget.findPath(tmp, waypoints[0], next, 0))
+            return 1;
+    const unsigned shrunk = (unsigned)budget.getTotalMemoryInUse();
+    if(shrunk >= peak)
+    {
+        std::cout << "Auto-shrink did not shrink!" << std::endl;
+        return 1;
+    }
+    // A limit of exactly what a search needs must let it finish: finding nodes that already exist takes no memory.
+    // This query reaches existing nodes while the node storage is full.
+    {
+        const JPS::Position a = JPS::Pos(3, 1), b = JPS::Pos(25, 2);
+        JPS::Searcher<MyGrid> unlimited(grid), exact(grid);
+        if(!unlimited.findPath(tmp, a, b, 0, JPS_Flag_AStarOnly | JPS_Flag_NoGreedy))
+            return 1;
+        exact.setMemoryLimit(unlimited.getTotalMemoryInUse());
+        if(!exact.findPath(tmp, a, b, 0, JPS_Flag_AStarOnly | JPS_Flag_NoGreedy))
+        {
+            std::cout << "Search failed at a memory limit it fits in!" << std::endl;
+            return 1;
+        }
+    }
+    // Heuristics learned in moving target mode count against the limit too
+    {
+        JPS::Searcher<MyGrid> chaser(grid);
+        chaser.setMemoryLimit(limit);
+        JPS::Position goal = waypoints[1];
+        for(unsigned i = 0; i < 30; ++i)
+        {
+            if(grid(goal.x - 1, goal.y))
+                --goal.x;
+            if(!chaser.findPath(tmp, waypoints[0], goal, 0, JPS_Flag_MovingTarget | JPS_Flag_NoGreedy)
+                || chaser.getTotalMemoryInUse() > limit)
+            {
+                std::cout << "Moving target search went over the memory limit: " << chaser.getTotalMemoryInUse() << " bytes" << std::endl;
+                return 1;
+            }
+        }
+    }
+    std::cout << "Memory limit " << limit << ": stopped at " << stopped << " bytes; auto-shrink: "
+              << peak << " -> " << shrunk << " bytes" << std::endl;
+
+    // Everything within a movement range in one bounded flood instead of one search per cell.
+    // 4-connected, so A* with the Manhattan estimate gives the exact cost to compare against.
+    const JPS::ScoreType range = 9;
+    JPS::Searcher<MyGrid> flood(grid), check(grid);
+    JPS::PathVector cells;
+    JPS::RangeBits bits;
+    if(!flood.floodRange(bits, waypoints[0], range, JPS_Flag_FourConnected)
+        || !flood.floodRange(cells, waypoints[0], range, JPS_Flag_FourConnected))
+        return 1;
+    unsigned inrange = 0;
+    for(unsigned y = 0; y < grid.h; ++y)
+        for(unsigned x = 0; x < grid.w; ++x)
+        {
+            const JPS::Position p = JPS::Pos(x, y);
+            const bool found = grid(x, y) && check.findPath(tmp, waypoints[0], p, 1, JPS_Flag_AStarOnly | JPS_Flag_FourConnected);
+            const bool expect = found && check.getPathLength(1) <= (JPS::SizeT)range;
+            JPS::ScoreType cost = -1;
+            const bool reached = flood.getRangeCost(p, cost);
+            if(bits(x, y) != expect || reached != expect)
+            {
+                std::cout << "Range mismatch at (" << x << ", " << y << ")" << std::endl;
+                return 1;
+            }
+            if(expect)
+            {
+                JPS::PathVector rp;
+                const bool traced = flood.getRangePath(rp, p, 1);
+                if(cost != (JPS::ScoreType)check.getPathLength(1) || !traced || rp.size() != (size_t)cost)
+                {
+                    std::cout << "Range cost or path wrong at (" << x << ", " << y << "): " << cost << std::endl;
+                    return 1;
+                }
+                ++inrange;
+            }
+        }
+    if(inrange != cells.size())
+    {
+        std::cout << "Range list has " << cells.size() << " cells, expected " << inrange << std::endl;
+        return 1;
+    }
+    std::cout << "Range " << range << ": " << inrange << " cells, " << flood.getNodesExpanded() << " nodes" << std::endl;
 	return 0;
 }
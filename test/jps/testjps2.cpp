@@ -2,13 +2,37 @@
 // Set working directory to test/jps (= where this file resides), then run:
 //  ./testjps maps/*.scen
 // for a quick benchmark and correctness test.
+// Files converted with mapconv can be passed instead:
+//  ./mapconv maps/*.scen && ./testjps maps/*.jpsb
+// Pass -record FILE before the map files to write a query trace for jpsreplay.
+// Every 32th query is also repeated for 2x2 and 3x3 agents, once with JPS::ClearanceGrid
+// and once with a grid wrapper that checks the whole square; both must give the same path.
+// Every 64th query is also turned into a chase: the goal walks towards the next query's goal,
+// the start walks along the current path, and each frame is searched with JPS_Flag_MovingTarget
+// and from scratch, both with the consistent (Chebyshev) estimate of ExactPolicy. Both must find a path
+// of the same cost; node counts and path costs are summed up at the end.
+// Every 16th query also casts rays from the start to the goal and to the first waypoints of the path,
+// through the map grid in both directions and through a JPS::BitGrid copy; all must agree. The query is
+// then repeated with JPS_Flag_RaycastGreedy, whose step path must be legal and, if the goal was visible,
+// exactly as many steps long as the Chebyshev distance.
+// Every 4th query is repeated on a JPS::DeadEndGrid and on the plain grid, both with a consistent
+// (Chebyshev) estimate so that the results are optimal; dead-end pruning must not change the path cost.
+// A JPS::EngineModel is calibrated on every map and its choice per distance band is printed
+// (with the sampled work of both engines). Every 16th query (offset by 8) is timed with JPS,
+// with A* and with JPS_Flag_AutoSelect; all must find a path. The times are used to fit the step and
+// node weights of the model, which are printed at the end.
 
 #include "jps.hh"
 
 #include <iostream>
 #include "ScenarioLoader.h"
+#include "BinMap.h"
+#include "JPSTrace.h"
 #include <fstream>
+#include <vector>
+#include <algorithm>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
 
@@ -86,75 +110,490 @@ static double pathcost(unsigned startx, unsigned starty, const JPS::PathVector&
 	return accu;
 }
 
-double runScenario(const char *file)
+// Slow reference for JPS::ClearanceGrid: a cell is walkable if the size x size square anchored there is
+template<typename GRID>
+struct SquareGrid
 {
-	ScenarioLoader loader(file);
-	if(!loader.GetNumExperiments())
-		die(file);
-	MapGrid grid(loader.GetNthExperiment(0).GetMapName());
-	double sum = 0;
-	JPS::PathVector path;
-	JPS::Searcher<MapGrid> search(grid);
-	for(unsigned i = 0; i < loader.GetNumExperiments(); ++i)
+	SquareGrid(const GRID& g) : g(g), size(1) {}
+
+	bool operator()(unsigned x, unsigned y) const
 	{
-		const Experiment& ex = loader.GetNthExperiment(i);
-		path.clear();
-		int runs = 0;
-
-		// single-call
-		//bool found = JPS::findPath(path, grid, ex.GetStartX(), ex.GetStartY(), ex.GetGoalX(), ex.GetGoalY(), 0, 0, &stepsDone, &nodesExpanded);
-
-		// Testing incremental runs
-		bool found = false;
-		const JPS::Position startpos = JPS::Pos(ex.GetStartX(), ex.GetStartY());
-		const JPS::Position endpos = JPS::Pos(ex.GetGoalX(), ex.GetGoalY());
-		JPS_Result res = search.findPathInit(startpos, endpos);
-		if(res == JPS_EMPTY_PATH)
-			found = true;
-		else
+		for(unsigned j = 0; j < size; ++j)
+			for(unsigned i = 0; i < size; ++i)
+				if(!g(x + i, y + j))
+					return false;
+		return true;
+	}
+
+	const GRID& g;
+	unsigned size;
+};
+
+enum { CLEARANCE_CHECK_EVERY = 32 };
+
+template<typename GRID>
+static void checkClearance(JPS::ClearanceGrid& cgrid, JPS::Searcher<JPS::ClearanceGrid>& csearch,
+	SquareGrid<GRID>& sgrid, JPS::Searcher<SquareGrid<GRID> >& ssearch, const char *file, unsigned i,
+	unsigned sx, unsigned sy, unsigned gx, unsigned gy)
+{
+	JPS::PathVector cpath, spath;
+	for(unsigned size = 2; size <= 3; ++size)
+	{
+		cgrid.setAgentSize(size);
+		sgrid.size = size;
+		cpath.clear();
+		spath.clear();
+		const bool cfound = csearch.findPath(cpath, JPS::Pos(sx, sy), JPS::Pos(gx, gy), 0);
+		const bool sfound = ssearch.findPath(spath, JPS::Pos(sx, sy), JPS::Pos(gx, gy), 0);
+		bool same = cfound == sfound && cpath.size() == spath.size();
+		for(size_t k = 0; same && k < cpath.size(); ++k)
+			same = cpath[k] == spath[k];
+		if(!same)
 		{
-			while(res == JPS_NEED_MORE_STEPS)
+			printf("#### [%s:%d] size %u: (%d, %d) -> (%d, %d): clearance %d, square %d\n",
+				file, i, size, sx, sy, gx, gy, cfound, sfound);
+			die("Clearance search differs");
+		}
+	}
+}
+
+enum { OUTPUT_CHECK_EVERY = 8 };
+
+// The caller-buffer output and the lazy step iterator must produce exactly what findPathFinish() does
+template<typename SEARCH>
+static void checkPathOutput(const SEARCH& search, JPS::Position start, const JPS::PathVector& waypoints, const char *file, unsigned i)
+{
+	if(search.getPathLength(0) != waypoints.size())
+		die("getPathLength(0) differs");
+	JPS::PathVector ref;
+	std::vector<JPS::Position> buf;
+	for(unsigned step = 1; step <= 3; step += 2)
+	{
+		ref.clear();
+		if(search.findPathFinish(ref, step) != JPS_FOUND_PATH)
+			die("findPathFinish failed");
+		const size_t len = search.getPathLength(step);
+		buf.assign(len + 1, JPS::npos);
+		if(len != ref.size() || (len && search.writePath(&buf[0], JPS::SizeT(len - 1), step) != len) || buf[0] != JPS::npos)
+			die("getPathLength() or short buffer check failed");
+		search.writePath(&buf[0], JPS::SizeT(len), step);
+		JPS::StepIterator it(start, waypoints.data(), waypoints.size(), step);
+		JPS::Position p;
+		for(size_t k = 0; k < len; ++k)
+			if(buf[k] != ref[k] || !it.next(p) || p != ref[k])
 			{
-				++runs;
-				res = search.findPathStep(10000);
+				printf("#### [%s:%d] step %u: output differs at %u\n", file, i, step, (unsigned)k);
+				die("Path output differs");
 			}
-			found = (res == JPS_FOUND_PATH) && search.findPathFinish(path, 0);
+		if(it.next(p) || buf[len] != JPS::npos)
+			die("Path output too long");
+	}
+}
+
+enum { RAYCAST_CHECK_EVERY = 16, RAYCAST_WAYPOINTS = 3 };
+
+struct RaycastStats
+{
+	unsigned rays, visible;
+};
+static RaycastStats rays;
+
+template<typename GRID>
+static void buildBitGrid(JPS::BitGrid& bits, const GRID& grid, unsigned w, unsigned h)
+{
+	if(!bits.init(w, h))
+		die("Out of memory");
+	for(unsigned y = 0; y < h; ++y)
+		for(unsigned x = 0; x < w; ++x)
+			bits.set(x, y, !!grid(x, y));
+}
+
+template<typename GRID>
+static void checkRaycast(const GRID& grid, const JPS::BitGrid& bits, JPS::Searcher<GRID>& search, const char *file, unsigned i,
+	JPS::Position start, const JPS::PathVector& waypoints)
+{
+	if(waypoints.empty())
+		return;
+	const JPS::Position goal = waypoints[waypoints.size() - 1];
+	bool goalVisible = false;
+	for(size_t k = 0; k <= RAYCAST_WAYPOINTS && k < waypoints.size(); ++k)
+	{
+		const JPS::Position t = k < RAYCAST_WAYPOINTS ? waypoints[k] : goal;
+		const bool v = JPS::raycast(grid, start, t);
+		if(v != JPS::raycast(grid, t, start) || v != JPS::raycast(bits, start, t))
+		{
+			printf("#### [%s:%d] ray (%d, %d) -> (%d, %d) differs\n", file, i, start.x, start.y, t.x, t.y);
+			die("Raycast differs");
 		}
+		++rays.rays;
+		rays.visible += v;
+		goalVisible |= v && t == goal;
+	}
+	JPS::PathVector path;
+	if(!search.findPath(path, start, goal, 1, JPS_Flag_RaycastGreedy) || path.back() != goal)
+		die("Raycast greedy search failed");
+	JPS::Position last = start;
+	for(size_t k = 0; k < path.size(); ++k)
+	{
+		const JPS::Position p = path[k];
+		if(abs(int(p.x - last.x)) > 1 || abs(int(p.y - last.y)) > 1 || !grid(p.x, p.y) || (!grid(p.x, last.y) && !grid(last.x, p.y)))
+			die("Raycast greedy path has an invalid step");
+		last = p;
+	}
+	const unsigned cheb = (unsigned)std::max(abs(int(goal.x - start.x)), abs(int(goal.y - start.y)));
+	if(goalVisible && path.size() != cheb)
+		die("Raycast greedy path is not the shortest");
+}
+
+// JPS_NO_FLOAT makes the path cost Chebyshev, so with this estimate every search is exactly optimal
+struct ExactPolicy : public JPS::DefaultPolicy
+{
+	template<typename POS>
+	static inline JPS::ScoreType Estimate(const POS& a, const POS& b)
+	{
+		return JPS::Heuristic::Chebyshev(a, b);
+	}
+};
+
+enum { DEADEND_CHECK_EVERY = 4 };
+
+struct DeadEndStats
+{
+	unsigned queries;
+	unsigned long nodes, nodesPruned;
+};
+static DeadEndStats deadends;
+
+template<typename GRID>
+static void checkDeadEnds(JPS::DeadEndGrid<GRID>& dgrid, JPS::Searcher<JPS::DeadEndGrid<GRID>, ExactPolicy>& dsearch,
+	JPS::Searcher<GRID, ExactPolicy>& esearch, const char *file, unsigned i, JPS::Position start, JPS::Position goal)
+{
+	JPS::PathVector pd, pe;
+	dgrid.setQuery(start, goal);
+	const bool fd = dsearch.findPath(pd, start, goal, 0);
+	const bool fe = esearch.findPath(pe, start, goal, 0);
+	if(fd != fe || dsearch.getPathLength(1) != esearch.getPathLength(1))
+	{
+		printf("#### [%s:%d] (%d, %d) -> (%d, %d): pruned %d, %u steps; plain %d, %u steps\n", file, i,
+			start.x, start.y, goal.x, goal.y, fd, (unsigned)dsearch.getPathLength(1), fe, (unsigned)esearch.getPathLength(1));
+		die("Dead-end pruning changed the result");
+	}
+	++deadends.queries;
+	deadends.nodesPruned += dsearch.getNodesExpanded();
+	deadends.nodes += esearch.getNodesExpanded();
+}
+
+enum { AUTO_CHECK_EVERY = 16, AUTO_CHECK_OFFSET = 8 };
 
-		if(!found)
+struct AutoStats
+{
+	unsigned queries, astarChosen;
+	double nanosAuto, nanosJPS, nanosAStar;
+	// Least squares fit of time = stepNanos * steps + nodeNanos * nodes over the JPS and A* runs
+	double ss, sn, nn, st, nt;
+};
+static AutoStats autosel;
+
+template<typename SEARCH>
+static double timedSearch(SEARCH& search, JPS::PathVector& path, JPS::Position start, JPS::Position goal, JPS_Flags flags, bool fit)
+{
+	path.clear();
+	const unsigned long long t0 = traceNanos();
+	const bool found = search.findPath(path, start, goal, 0, flags);
+	const double t = double(traceNanos() - t0);
+	if(!found)
+		die("Path not found with automatic engine selection");
+	if(fit)
+	{
+		const double s = double(search.getStepsDone()), n = double(search.getNodesExpanded());
+		autosel.ss += s * s;
+		autosel.sn += s * n;
+		autosel.nn += n * n;
+		autosel.st += s * t;
+		autosel.nt += n * t;
+	}
+	return t;
+}
+
+// One line per calibrated distance band, so the engine chosen for each query distance can be checked
+static void printEngineModel(const JPS::EngineModel& model)
+{
+	for(unsigned b = 0; b < JPS::EngineModel::NUM_BUCKETS; ++b)
+		if(model.getNumSamples(b))
+			printf("  distance %u..%u: %s (work JPS %lu, A* %lu, %u samples)\n", 1u << b, (2u << b) - 1,
+				model.prefersAStar(b) ? "A*" : "JPS", model.getWork(b, false), model.getWork(b, true), model.getNumSamples(b));
+}
+
+// Separate searchers, so that no search pays for clearing the nodes of a different engine
+template<typename SEARCH>
+static void checkAutoSelect(SEARCH& search, SEARCH& jsearch, SEARCH& asearch, JPS::Position start, JPS::Position goal)
+{
+	JPS::PathVector path;
+	autosel.nanosAuto += timedSearch(search, path, start, goal, JPS_Flag_AutoSelect, false);
+	if(path.empty() ? start != goal : path.back() != goal)
+		die("Automatic engine selection found a wrong path");
+	autosel.nanosJPS += timedSearch(jsearch, path, start, goal, JPS_Flag_RaycastGreedy, true);
+	autosel.nanosAStar += timedSearch(asearch, path, start, goal, JPS_Flag_RaycastGreedy | JPS_Flag_AStarOnly, true);
+	++autosel.queries;
+	autosel.astarChosen += search.getEngineModel()->select(start, goal) && !JPS::raycast(search.getGrid(), start, goal);
+}
+
+enum { CHASE_CHECK_EVERY = 64, CHASE_FRAMES = 48 };
+
+struct ChaseStats
+{
+	unsigned searches;
+	unsigned long nodesMT, nodesFresh;
+	double costMT, costFresh;
+};
+static ChaseStats chase;
+
+template<typename SEARCH>
+static void runChase(SEARCH& mt, SEARCH& fresh, const char *file, unsigned i,
+	JPS::Position start, JPS::Position goal, JPS::Position goal2)
+{
+	JPS::PathVector target, pm, pf;
+	if(!fresh.findPath(target, goal, goal2, 1))
+		return;
+	mt.resetMovingTarget();
+	JPS::Position a = start;
+	for(unsigned k = 0; k < CHASE_FRAMES && k < target.size(); ++k)
+	{
+		const JPS::Position t = target[k];
+		if(a == t)
+			break;
+		pm.clear();
+		pf.clear();
+		const bool fm = mt.findPath(pm, a, t, 0, JPS_Flag_MovingTarget);
+		const bool ff = fresh.findPath(pf, a, t, 0);
+		if(fm != ff || !fm || pm.back() != t)
+		{
+			printf("#### [%s:%d] chase frame %u: (%d, %d) -> (%d, %d): MT %d, fresh %d\n",
+				file, i, k, a.x, a.y, t.x, t.y, fm, ff);
+			die("Moving target search failed");
+		}
+		// same metric as the search itself (diagonal steps cost 1 with the default int scores)
+		const unsigned lm = (unsigned)mt.getPathLength(1), lf = (unsigned)fresh.getPathLength(1);
+		if(lm != lf)
+		{
+			printf("#### [%s:%d] chase frame %u: (%d, %d) -> (%d, %d): MT cost %u, fresh %u\n",
+				file, i, k, a.x, a.y, t.x, t.y, lm, lf);
+			die("Moving target search changed the path cost");
+		}
+		++chase.searches;
+		chase.nodesMT += mt.getNodesExpanded();
+		chase.nodesFresh += fresh.getNodesExpanded();
+		chase.costMT += pathcost(a.x, a.y, pm);
+		chase.costFresh += pathcost(a.x, a.y, pf);
+		// the chaser moves one cell along its path
+		JPS::StepIterator it(a, pm.data(), pm.size(), 1);
+		it.next(a);
+	}
+}
+
+static TraceWriter trace;
+
+template<typename SEARCH>
+static double runQuery(SEARCH& search, JPS::PathVector& path, const char *file, unsigned i,
+	unsigned sx, unsigned sy, unsigned gx, unsigned gy, double dist)
+{
+	path.clear();
+	int runs = 0;
+
+	// single-call
+	//bool found = JPS::findPath(path, grid, sx, sy, gx, gy, 0, 0, &stepsDone, &nodesExpanded);
+
+	// Testing incremental runs
+	bool found = false;
+	const JPS::Position startpos = JPS::Pos(sx, sy);
+	const JPS::Position endpos = JPS::Pos(gx, gy);
+	JPS_Result res = search.findPathInit(startpos, endpos);
+	if(res == JPS_EMPTY_PATH)
+		found = true;
+	else
+	{
+		while(res == JPS_NEED_MORE_STEPS)
 		{
-			printf("#### [%s:%d] PATH NOT FOUND: (%d, %d) -> (%d, %d)\n",
-				file, i, ex.GetStartX(), ex.GetStartY(), ex.GetGoalX(), ex.GetGoalY());
-			die("Path not found!"); // all paths known to be valid, so this is bad
-			continue;
+			++runs;
+			res = search.findPathStep(10000);
 		}
+		found = (res == JPS_FOUND_PATH) && search.findPathFinish(path, 0);
+	}
 
-		assert((path.empty() && startpos == endpos) || path.back() == endpos);
+	if(!found)
+	{
+		printf("#### [%s:%d] PATH NOT FOUND: (%d, %d) -> (%d, %d)\n",
+			file, i, sx, sy, gx, gy);
+		die("Path not found!"); // all paths known to be valid, so this is bad
+	}
 
-		// Starting position is NOT included in vector
-		double cost = pathcost(ex.GetStartX(), ex.GetStartY(), path);
+	assert((path.empty() && startpos == endpos) || path.back() == endpos);
+	if(i % OUTPUT_CHECK_EVERY == 0 && !path.empty())
+		checkPathOutput(search, startpos, path, file, i);
+
+	// Starting position is NOT included in vector
+	double cost = pathcost(sx, sy, path);
 #if 0
-		//if(cost > ex.GetDistance()+0.5f)
-			printf("[%s] [%s:%d] Path len: %.3f (%.3f); Diff: %.3f; Steps: %u; Nodes: %u; Runs: %u\n",
-				(cost > ex.GetDistance()+0.5f ? "##" : "  "), file, i, cost, ex.GetDistance(),
-				fabs(cost - ex.GetDistance()), (unsigned)search.getStepsDone(), (unsigned)search.getNodesExpanded(), runs);
+	//if(cost > dist+0.5f)
+		printf("[%s] [%s:%d] Path len: %.3f (%.3f); Diff: %.3f; Steps: %u; Nodes: %u; Runs: %u\n",
+			(cost > dist+0.5f ? "##" : "  "), file, i, cost, dist,
+			fabs(cost - dist), (unsigned)search.getStepsDone(), (unsigned)search.getNodesExpanded(), runs);
 #else
-        (void)runs;
+	(void)runs;
+	(void)dist;
 #endif
+	return cost;
+}
+
+// One query of a scenario, whichever file format it came from
+struct Query
+{
+	JPS::Position start, goal;
+	double dist;
+};
+
+// Scenario sources for runMap()
+struct TextScenarios
+{
+	const ScenarioLoader& loader;
+	unsigned size() const { return loader.GetNumExperiments(); }
+	Query operator[](unsigned i) const
+	{
+		const Experiment& ex = loader.GetNthExperiment(i);
+		const Query q = { JPS::Pos(ex.GetStartX(), ex.GetStartY()), JPS::Pos(ex.GetGoalX(), ex.GetGoalY()), ex.GetDistance() };
+		return q;
+	}
+};
 
-		sum += cost;
+struct BinScenarios
+{
+	const BinMap& bin;
+	unsigned size() const { return bin.getNumScenarios(); }
+	Query operator[](unsigned i) const
+	{
+		const BinScenario& ex = bin.getScenario(i);
+		const Query q = { JPS::Pos(ex.startx, ex.starty), JPS::Pos(ex.goalx, ex.goaly), ex.distance };
+		return q;
 	}
-    printf("Done. Req. memory: %u KB\n", (unsigned)search.getTotalMemoryInUse() / 1024);
+};
+
+// Runs all queries of a map, and the extra checks on every n-th of them.
+// cltable is a precomputed clearance table for the grid, or NULL to build one.
+template<typename GRID, typename SCEN>
+static double runMap(const char *file, const GRID& grid, unsigned w, unsigned h, const SCEN& queries, const unsigned char *cltable)
+{
+	double sum = 0;
+	JPS::PathVector path;
+	TracedSearcher<GRID> search(grid, trace.isOpen() ? &trace : NULL);
+	if(trace.isOpen())
+		trace.grid(w, h, gridChecksum(grid, w, h));
+	JPS::ClearanceMap cmap;
+	if(!cltable)
+	{
+		if(!cmap.build(grid, w, h))
+			die("Out of memory");
+		cltable = cmap.getData();
+	}
+	JPS::ClearanceGrid cgrid(cltable, w, h);
+	JPS::Searcher<JPS::ClearanceGrid> csearch(cgrid);
+	SquareGrid<GRID> sgrid(grid);
+	JPS::Searcher<SquareGrid<GRID> > ssearch(sgrid);
+	JPS::Searcher<GRID> freshsearch(grid);
+	JPS::BitGrid bits;
+	buildBitGrid(bits, grid, w, h);
+	JPS::DeadEndMap dmap;
+	if(!dmap.build(grid, w, h))
+		die("Out of memory");
+	JPS::DeadEndGrid<GRID> dgrid(grid, dmap);
+	JPS::Searcher<JPS::DeadEndGrid<GRID>, ExactPolicy> dsearch(dgrid);
+	JPS::Searcher<GRID, ExactPolicy> esearch(grid), mtsearch(grid);
+	JPS::Searcher<GRID> autosearch(grid), astarsearch(grid);
+	JPS::EngineModel model;
+	model.calibrate(autosearch, w, h);
+	autosearch.setEngineModel(&model);
+	printEngineModel(model);
+	for(unsigned i = 0; i < queries.size(); ++i)
+	{
+		const Query q = queries[i];
+		sum += runQuery(search, path, file, i, q.start.x, q.start.y, q.goal.x, q.goal.y, q.dist);
+		if(i % RAYCAST_CHECK_EVERY == 0)
+			checkRaycast(grid, bits, freshsearch, file, i, q.start, path);
+		if(i % DEADEND_CHECK_EVERY == 0)
+			checkDeadEnds(dgrid, dsearch, esearch, file, i, q.start, q.goal);
+		if(i % AUTO_CHECK_EVERY == AUTO_CHECK_OFFSET)
+			checkAutoSelect(autosearch, freshsearch, astarsearch, q.start, q.goal);
+		if(i % CLEARANCE_CHECK_EVERY == 0)
+			checkClearance(cgrid, csearch, sgrid, ssearch, file, i, q.start.x, q.start.y, q.goal.x, q.goal.y);
+		if(i % CHASE_CHECK_EVERY == 0 && i + 1 < queries.size())
+			runChase(mtsearch, esearch, file, i, q.start, q.goal, queries[i + 1].goal);
+	}
+	printf("Done. Req. memory: %u KB\n", (unsigned)search.getTotalMemoryInUse() / 1024);
 	return sum;
 }
 
+double runScenario(const char *file)
+{
+	ScenarioLoader loader(file);
+	if(!loader.GetNumExperiments())
+		die(file);
+	MapGrid grid(loader.GetNthExperiment(0).GetMapName());
+	const TextScenarios queries = { loader };
+	return runMap(file, grid, grid.w, grid.h, queries, NULL);
+}
+
+// Same as runScenario(), but for a .jpsb file written by mapconv
+double runBinary(const char *file)
+{
+	BinMap bin;
+	if(!bin.load(file) || !bin.getNumScenarios())
+		die(file);
+	std::cout << "[" << file << "] W: " << bin.getWidth() << "; H: " << bin.getHeight() << "; Total cells: " << (bin.getWidth()*bin.getHeight()) << std::endl;
+	const BinScenarios queries = { bin };
+	// Use the precomputed clearance table if the file has one (load() checked its size)
+	return runMap(file, bin, bin.getWidth(), bin.getHeight(), queries, (const unsigned char*)bin.getTable(BINMAP_TABLE_CLEARANCE));
+}
+
+static bool isBinary(const char *file)
+{
+	const size_t len = strlen(file);
+	return len > 5 && !strcmp(file + len - 5, ".jpsb");
+}
+
 int main(int argc, char **argv)
 {
+	int first = 1;
+	if(argc > 2 && !strcmp(argv[1], "-record"))
+	{
+		if(!trace.open(argv[2]))
+			die(argv[2]);
+		first = 3;
+	}
+
 	double sum = 0;
-	for(int i = 1; i < argc; ++i)
-		sum += runScenario(argv[i]);
+	for(int i = first; i < argc; ++i)
+		sum += isBinary(argv[i]) ? runBinary(argv[i]) : runScenario(argv[i]);
 
 	std::cout << "Total distance travelled: " << sum << std::endl;
+	if(rays.rays)
+		printf("Raycast: %u of %u rays visible\n", rays.visible, rays.rays);
+	if(deadends.queries)
+		printf("Dead-end pruning: %u searches; nodes expanded %lu (%lu without pruning)\n",
+			deadends.queries, deadends.nodesPruned, deadends.nodes);
+	if(autosel.queries)
+	{
+		printf("Auto select: %u searches, A* chosen for %u; time %.1f ms (JPS %.1f ms, A* %.1f ms)\n",
+			autosel.queries, autosel.astarChosen, autosel.nanosAuto * 1e-6, autosel.nanosJPS * 1e-6, autosel.nanosAStar * 1e-6);
+		const double det = autosel.ss * autosel.nn - autosel.sn * autosel.sn;
+		if(det > 0)
+		{
+			const double stepNanos = (autosel.st * autosel.nn - autosel.nt * autosel.sn) / det;
+			const double nodeNanos = (autosel.nt * autosel.ss - autosel.st * autosel.sn) / det;
+			printf("Engine model weights: %.1f ns per step, %.1f ns per node (1:%.1f)\n", stepNanos, nodeNanos, nodeNanos / stepNanos);
+		}
+	}
+	if(chase.searches)
+		printf("Moving target: %u searches; nodes expanded %lu (%lu from scratch); path cost %.1f (%.1f from scratch)\n",
+			chase.searches, chase.nodesMT, chase.nodesFresh, chase.costMT, chase.costFresh);
 
 	return 0;
 }
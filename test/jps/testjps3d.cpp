@@ -0,0 +1,138 @@
+// Randomized test for JPS3D: builds voxel maps of varying obstacle density
+// and checks that JPS finds a path exactly when plain A* does, and one of the same cost.
+// How to use:
+//  ./testjps3d [seed]
+
+// The default estimate (Manhattan) overestimates diagonal moves, so the paths would not be optimal.
+// Chebyshev is the exact cost of the default integer scores; both engines must then find equally long paths.
+#define JPS_HEURISTIC_ESTIMATE(a, b) (Heuristic::Chebyshev(a, b))
+#include "jps.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void die(const char *msg)
+{
+	fprintf(stderr, "%s\n", msg);
+	abort();
+}
+
+static unsigned rng(unsigned& state)
+{
+	state = state * 1103515245u + 12345u;
+	return state >> 8;
+}
+
+// Every consecutive pair of positions in a step-1 path must be a legal move
+static void checkSteps(const JPS3D::VoxelGrid& grid, JPS3D::Position start, const JPS3D::PathVector& path)
+{
+	JPS3D::Position last = start;
+	for(size_t i = 0; i < path.size(); ++i)
+	{
+		const JPS3D::Position p = path[i];
+		const int dx = int(p.x - last.x), dy = int(p.y - last.y), dz = int(p.z - last.z);
+		if(abs(dx) > 1 || abs(dy) > 1 || abs(dz) > 1 || !grid(p.x, p.y, p.z))
+			die("Invalid step in path");
+		for(int c = 0; c <= !!dz; ++c)
+			for(int b = 0; b <= !!dy; ++b)
+				for(int a = 0; a <= !!dx; ++a)
+					if(!grid(last.x + a*dx, last.y + b*dy, last.z + c*dz))
+						die("Path cuts a corner");
+		last = p;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned seed = argc > 1 ? atoi(argv[1]) : 42;
+	const unsigned W = 48, H = 48, D = 16;
+	const unsigned densities[] = { 0, 10, 25, 40 };
+	unsigned long sumJPS = 0, sumAStar = 0;
+	unsigned long nodesJPS = 0, nodesAStar = 0;
+	unsigned found = 0, notfound = 0;
+
+	JPS3D::VoxelGrid grid;
+	if(!grid.init(W, H, D))
+		die("Out of memory");
+	JPS3D::Searcher<JPS3D::VoxelGrid> search(grid);
+	JPS3D::PathVector pj, pa, ps;
+
+	for(unsigned di = 0; di < sizeof(densities) / sizeof(densities[0]); ++di)
+	{
+		for(unsigned z = 0; z < D; ++z)
+			for(unsigned y = 0; y < H; ++y)
+				for(unsigned x = 0; x < W; ++x)
+					grid.set(x, y, z, rng(seed) % 100 >= densities[di]);
+
+		for(unsigned q = 0; q < 200; ++q)
+		{
+			JPS3D::Position a = JPS3D::Pos(rng(seed) % W, rng(seed) % H, rng(seed) % D);
+			JPS3D::Position b = JPS3D::Pos(rng(seed) % W, rng(seed) % H, rng(seed) % D);
+			grid.set(a.x, a.y, a.z, true);
+			grid.set(b.x, b.y, b.z, true);
+
+			pj.clear();
+			pa.clear();
+			ps.clear();
+			const bool fj = search.findPath(pj, a, b, 0);
+			const unsigned lj = fj ? (unsigned)search.getPathLength(1) : 0;
+			nodesJPS += search.getNodesExpanded();
+			const bool fa = search.findPath(pa, a, b, 0, JPS_Flag_AStarOnly);
+			const unsigned la = fa ? (unsigned)search.getPathLength(1) : 0;
+			nodesAStar += search.getNodesExpanded();
+			if(fj != fa || lj != la)
+			{
+				fprintf(stderr, "#### density %u%%, (%u, %u, %u) -> (%u, %u, %u): JPS %d (cost %u), A* %d (cost %u)\n",
+					densities[di], a.x, a.y, a.z, b.x, b.y, b.z, fj, lj, fa, la);
+				die("JPS and A* disagree");
+			}
+			if(!fj)
+			{
+				++notfound;
+				continue;
+			}
+			++found;
+			if(!search.findPath(ps, a, b, 1))
+				die("Step path failed");
+			checkSteps(grid, a, ps);
+			if(a != b && (pj.back() != b || ps.back() != b))
+				die("Path does not end at goal");
+			sumJPS += lj;
+			sumAStar += la;
+		}
+	}
+
+	// Moving target: the goal wanders one voxel per query, the chaser takes one step toward it.
+	// Whether a path exists must not depend on the learned heuristic.
+	JPS3D::Searcher<JPS3D::VoxelGrid> fresh(grid);
+	unsigned long nodesMT = 0, nodesFresh = 0;
+	JPS3D::Position chaser = JPS3D::Pos(0, 0, 0), target = JPS3D::Pos(W - 1, H - 1, D - 1);
+	grid.set(chaser.x, chaser.y, chaser.z, true);
+	grid.set(target.x, target.y, target.z, true);
+	for(unsigned q = 0; q < 400 && chaser != target; ++q)
+	{
+		const JPS3D::Position next = JPS3D::Pos(target.x + rng(seed) % 3 - 1, target.y + rng(seed) % 3 - 1, target.z + rng(seed) % 3 - 1);
+		if(next.x < W && next.y < H && next.z < D && grid(next.x, next.y, next.z))
+			target = next;
+		pj.clear();
+		pa.clear();
+		const bool fm = search.findPath(pj, chaser, target, 1, JPS_Flag_MovingTarget);
+		nodesMT += search.getNodesExpanded();
+		const bool ff = fresh.findPath(pa, chaser, target, 1);
+		nodesFresh += fresh.getNodesExpanded();
+		if(fm != ff)
+			die("Moving target search and fresh search disagree");
+		if(!fm)
+			break;
+		checkSteps(grid, chaser, pj);
+		if(!pj.empty())
+			chaser = pj[0];
+	}
+
+	printf("Paths found: %u, not found: %u\n", found, notfound);
+	printf("JPS: total cost %lu, nodes %lu\n", sumJPS, nodesJPS);
+	printf("A*:  total cost %lu, nodes %lu\n", sumAStar, nodesAStar);
+	printf("Moving target: nodes %lu (%lu from scratch), %s\n", nodesMT, nodesFresh, chaser == target ? "caught" : "not caught");
+	printf("Memory used: %u bytes\n", (unsigned)(search.getTotalMemoryInUse() + grid._getMemSize()));
+	return 0;
+}
@@ -0,0 +1,152 @@
+// Randomized test for JPS::WeightedSearcher: builds terrain maps with roads,
+// swamps and walls and checks that the jump-based search finds paths of
+// exactly the same cost as plain weighted A*.
+// How to use:
+//  ./testjpsweighted [seed]
+
+#include "jps.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static void die(const char *msg)
+{
+	fprintf(stderr, "%s\n", msg);
+	abort();
+}
+
+static unsigned rng(unsigned& state)
+{
+	state = state * 1103515245u + 12345u;
+	return state >> 8;
+}
+
+struct CostGrid
+{
+	CostGrid(unsigned w, unsigned h) : w(w), h(h), cells(w * h, 0) {}
+
+	// Cost of the tile at (x, y); 0 = not walkable
+	inline unsigned operator()(unsigned x, unsigned y) const
+	{
+		return x < w && y < h ? cells[y * w + x] : 0;
+	}
+
+	void fill(unsigned x0, unsigned y0, unsigned x1, unsigned y1, unsigned char c)
+	{
+		for(unsigned y = y0; y < y1 && y < h; ++y)
+			for(unsigned x = x0; x < x1 && x < w; ++x)
+				cells[y * w + x] = c;
+	}
+
+	unsigned w, h;
+	std::vector<unsigned char> cells;
+};
+
+enum { GRASS = 3, ROAD = 1, ROUGH = 5, SWAMP = 9 };
+
+static void generate(CostGrid& g, unsigned& seed, unsigned walls)
+{
+	g.fill(0, 0, g.w, g.h, GRASS);
+	for(unsigned i = 0; i < 12; ++i)
+	{
+		const unsigned x = rng(seed) % g.w, y = rng(seed) % g.h;
+		g.fill(x, y, x + 4 + rng(seed) % 24, y + 4 + rng(seed) % 24, (i & 1) ? SWAMP : ROUGH);
+	}
+	for(unsigned i = 0; i < 6; ++i)
+	{
+		const unsigned x = rng(seed) % g.w, y = rng(seed) % g.h;
+		if(i & 1)
+			g.fill(x, 0, x + 1 + i % 3, g.h, ROAD);
+		else
+			g.fill(0, y, g.w, y + 1 + i % 3, ROAD);
+	}
+	for(unsigned i = 0; i < walls; ++i)
+	{
+		const unsigned x = rng(seed) % g.w, y = rng(seed) % g.h;
+		if(rng(seed) & 1)
+			g.fill(x, y, x + 1, y + 2 + rng(seed) % 20, 0);
+		else
+			g.fill(x, y, x + 2 + rng(seed) % 20, y + 1, 0);
+	}
+}
+
+// Re-add the cost of a step-1 path and check that every move is legal
+static unsigned stepcost(const CostGrid& g, JPS::Position start, const JPS::PathVector& path)
+{
+	unsigned accu = 0;
+	JPS::Position last = start;
+	for(size_t i = 0; i < path.size(); ++i)
+	{
+		const JPS::Position p = path[i];
+		const int dx = int(p.x - last.x), dy = int(p.y - last.y);
+		if(abs(dx) > 1 || abs(dy) > 1 || !g(p.x, p.y))
+			die("Invalid step in path");
+		if(dx && dy && !g(last.x + dx, last.y) && !g(last.x, last.y + dy))
+			die("Path tunnels through a corner");
+		accu += (dx && dy ? 7 : 5) * (g(last.x, last.y) + g(p.x, p.y));
+		last = p;
+	}
+	return accu;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned seed = argc > 1 ? atoi(argv[1]) : 42;
+	const unsigned W = 160, H = 120;
+	const unsigned wallcounts[] = { 0, 40, 150 };
+	unsigned long costJPS = 0, costAStar = 0, nodesJPS = 0, nodesAStar = 0;
+	unsigned found = 0, notfound = 0;
+
+	CostGrid grid(W, H);
+	JPS::WeightedSearcher<CostGrid> search(grid, ROAD);
+	JPS::PathVector pj, pa, ps;
+
+	for(unsigned m = 0; m < 30; ++m)
+	{
+		generate(grid, seed, wallcounts[m % 3]);
+		for(unsigned q = 0; q < 40; ++q)
+		{
+			const JPS::Position a = JPS::Pos(rng(seed) % W, rng(seed) % H);
+			const JPS::Position b = JPS::Pos(rng(seed) % W, rng(seed) % H);
+			if(!grid(a.x, a.y) || !grid(b.x, b.y) || a == b)
+				continue;
+
+			pj.clear();
+			pa.clear();
+			ps.clear();
+			const bool fj = search.findPath(pj, a, b, 0);
+			const unsigned cj = search.getPathCost();
+			nodesJPS += search.getNodesExpanded();
+			const bool fa = search.findPath(pa, a, b, 0, JPS_Flag_AStarOnly);
+			const unsigned ca = search.getPathCost();
+			nodesAStar += search.getNodesExpanded();
+			if(fj != fa || (fj && cj != ca))
+			{
+				fprintf(stderr, "#### map %u, (%u, %u) -> (%u, %u): JPS %d cost %u, A* %d cost %u\n",
+					m, a.x, a.y, b.x, b.y, fj, cj, fa, ca);
+				die("JPS and A* disagree");
+			}
+			if(!fj)
+			{
+				++notfound;
+				continue;
+			}
+			++found;
+			if(!search.findPath(ps, a, b, 1))
+				die("Step path failed");
+			if(ps.back() != b || pj.back() != b)
+				die("Path does not end at goal");
+			if(stepcost(grid, a, ps) != cj)
+				die("Path cost does not match the reported cost");
+			costJPS += cj;
+			costAStar += ca;
+		}
+	}
+
+	printf("Paths found: %u, not found: %u\n", found, notfound);
+	printf("JPS: total cost %lu, nodes %lu\n", costJPS, nodesJPS);
+	printf("A*:  total cost %lu, nodes %lu\n", costAStar, nodesAStar);
+	printf("Memory used: %u bytes\n", (unsigned)search.getTotalMemoryInUse());
+	return 0;
+}
@@ -9,15 +9,16 @@ int main()
 {
     LuaAlloc *LA = luaalloc_create(0, 0);
     const char *fn[] = { "", "test.lua" };
-    int ret = runlua(2, fn, luaalloc, LA);
+    int ret = runlua(2, fn, (void*)luaalloc, LA);
+    printf("trimmed %zu bytes\n", luaalloc_trim(LA));
 
     const size_t *alive, *total, *blocks;
-    unsigned step, n = luaalloc_getstats(LA, &alive, &total, &blocks, &step);
+    unsigned n = luaalloc_getstats(LA, &alive, &total, &blocks, NULL);
     if(n)
     {
-        for(unsigned i = 0, a = 1, b = step; i < n-1; ++i, a = b+1, b += step)
+        for(unsigned i = 0, a = 1; i < n-1; a = luaalloc_binsize(i++) + 1)
             printf("%zu blocks of %u..%u bytes: %zu allocations alive, %zu done all-time\n",
-                    blocks[i],    a,  b,        alive[i],              total[i]);
+                    blocks[i],    a,  luaalloc_binsize(i), alive[i],   total[i]);
         printf("large allocations: %zu alive, %zu done all-time\n", alive[n-1], total[n-1]);
     }
     luaalloc_delete(LA);